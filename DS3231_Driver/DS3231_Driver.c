@@ -30,82 +30,29 @@ uint8_t DS3231_Init(DS3231* dev, I2C_HandleTypeDef* i2cHandle)
 
 	dev->status = 0; //status of last I2C-Transaction
 
-	uint8_t errors = 0;
-
-
-
-	//Check for Power on Reset values
-	if(DS3231_IsOscillatorSet(dev))
-	{
-		if(dev->status != HAL_OK)
-		{
-			errors++;
-		}
-	}
-	if(DS3231_IsBBSQWSet(dev))
-	{
-		if(dev->status != HAL_OK)
-		{
-			errors++;
-		}
-	}
-	if(DS3231_IsRateSelectSet(dev))
-	{
-		if(dev->status != HAL_OK)
-		{
-			errors++;
-		}
-	}
-
-	if(DS3231_IsInterruptSet(dev))
-	{
-		if(dev->status != HAL_OK)
-		{
-		errors++;
-		}
-	}
-
-	if(DS3231_Is32kHzSet(dev))
-	{
-		if(dev->status != HAL_OK)
-		{
-			errors++;
-		}
-	}
+	dev->bus_hz = DS3231_BUS_HZ;
+	dev->retries = DS3231_RETRIES;
+	dev->recover = NULL;
+	dev->stats = (DS3231_BusStats){0};
 
-	//Clear Flags
-	DS3231_ClearAlarm1Flag(dev);
-	if(dev->status != HAL_OK)
-	{
-		errors++;
-	}
-
-	DS3231_ClearAlarm2Flag(dev);
-	if(dev->status != HAL_OK)
-	{
-		errors++;
-	}
-
-	DS3231_ClearOscillatorStoppedFlag(dev);
-	if(dev->status != HAL_OK)
-	{
-		errors++;
-	}
-
-	//Disable Alarms & Set INTCN to Alarms
-	DS3231_Alarm1Enable(dev,Disabled);
-	if(dev->status != HAL_OK)
-	{
-		errors++;
-	}
+	uint8_t errors = 0;
 
-	DS3231_Alarm2Enable(dev,Disabled);
+	//Load the shadow registers (one read), keep oscillator, BBSQW, rate and 32kHz as they are
+	dev->shadow_valid = 0;
+	DS3231_Config config;
+	DS3231_GetConfig(dev,&config);
 	if(dev->status != HAL_OK)
 	{
 		errors++;
+		return errors;
 	}
 
-	DS3231_InterruptEnable(dev,Enabled);
+	//Clear Flags, Disable Alarms & Set INTCN to Alarms (one write)
+	config.interrupt = Enabled;
+	config.alarm1 = Disabled;
+	config.alarm2 = Disabled;
+	config.clear_flags = (1U << DS3231_OSF) | (1U << DS3231_A2F) | (1U << DS3231_A1F);
+	DS3231_ApplyConfig(dev,&config);
 	if(dev->status != HAL_OK)
 	{
 		errors++;
@@ -124,6 +71,34 @@ uint8_t BCDToDec(uint8_t bin) {
     return ((bin >> 4) * 10) + (bin & 0x0F);
 }
 
+static uint8_t DS3231_DecodeHours(uint8_t hours) //hours register in either mode to 0-23
+{
+	if(DS_READ_BIT(hours,DS3231_12_24) == 0) //24 hour mode: 20 hour and 10 hour bits are both part of the value
+	{
+		return BCDToDec(hours & 0x3F);
+	}
+	uint8_t hour = BCDToDec(hours & 0x1F) % 12; //12 AM is 0, 12 PM is 12
+	if(DS_READ_BIT(hours,DS3231_AM_PM_20_HOUR) == 1)
+	{
+		hour = hour + 12;
+	}
+	return hour;
+}
+static uint8_t DS3231_EncodeHours(uint8_t hours, uint8_t hour) //0-23 to the hours register, in the mode hours is already in
+{
+	if(DS_READ_BIT(hours,DS3231_12_24) == 0)
+	{
+		return DecToBCD(hour);
+	}
+	uint8_t reg = 0x40 | DecToBCD(hour % 12 == 0 ? 12 : hour % 12);
+	if(hour >= 12)
+	{
+		DS_SET_BIT(reg,DS3231_AM_PM_20_HOUR);
+	}
+	return reg;
+}
+static uint8_t DS3231_Shadow(DS3231* dev, uint8_t reg);
+
 
 //Time Functions
 void DS3231_GetSeconds(DS3231* dev)
@@ -164,21 +139,8 @@ void DS3231_GetHours(DS3231* dev)
 	dev->status = DS3231_ReadRegister(dev,DS3231_HOURS_REG,&hours);
 	if(dev->status == HAL_OK)
 	{
-		if(DS_READ_BIT(hours,DS3231_12_24) == 0) //If already in 24 hour mode
-		{
-			dev->time[2] = BCDToDec(hours & 0x6F);
-			return;
-		}
-		else //convert current AM/PM hours to 24-Hour Formats
-		{
-			uint8_t hour = BCDToDec(hours &0x1F);
-			if(DS_READ_BIT(hours,DS3231_AM_PM_20_HOUR) == 1)
-			{
-				hour = hours + 12;
-			}
-			dev->time[2] = hour;
-			return;
-		}
+		dev->time[2] = DS3231_DecodeHours(hours);
+		return;
 	}
 	else
 	{
@@ -211,45 +173,13 @@ void DS3231_SetMinutes(DS3231* dev, uint8_t min)
 
 void DS3231_SetHours(DS3231* dev, uint8_t hour)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_HOURS_REG,&control);
-
-	uint8_t time = 0;
+	uint8_t mode = DS3231_Shadow(dev,DS3231_HOURS_REG); //12/24 bit only changes through the driver
 
 	if(dev->status == HAL_OK)
 	{
-		uint8_t bit_12_24 = DS_READ_BIT(control,DS3231_12_24);
-		if(bit_12_24 == 1) //if 12/24 bit is set (12-Hour Mode/ AM/PM enabled)
-		{
-			uint8_t bits12 = control & 0xE0; //preserves 12/24 bit & AM/PM bit
-
-			uint8_t pm = (hour >= 12);
-			uint8_t hours_pm = hour % 12;
-			if(hours_pm==0)
-			{
-				hours_pm = 12;
-			}
-
-			if(pm)
-			{
-				DS_SET_BIT(bits12,DS3231_AM_PM_20_HOUR);
-			}
-
-			uint8_t conv = DecToBCD(hours_pm & 0x1F);
-			time = bits12 | conv;
-		}
-		else //if 12_24 bit is not set (24-Hour Mode enabled)
-		{
-			uint8_t bits24 = control & 0xC0; //preserves 12/24 bit
-
-			uint8_t conv = DecToBCD(hour & 0x3F);
-
-			time = bits24 | conv;
-		}
-
+		uint8_t time = DS3231_EncodeHours(mode,hour); //keeps the 12/24 mode, sets AM/PM from hour
 		dev->status = DS3231_WriteRegister(dev,DS3231_HOURS_REG,&time);
 		return;
-
 	}
 	else
 	{
@@ -260,66 +190,23 @@ void DS3231_SetHours(DS3231* dev, uint8_t hour)
 
 void DS3231_SetHourMode(DS3231* dev, DS3231_HourMode mode)
 {
+	uint8_t bit_12_24 = (mode == Hour_12_AM_PM) << DS3231_12_24;
+	if(DS3231_Shadow(dev,DS3231_HOURS_REG) == bit_12_24 || dev->status != HAL_OK) //already in that mode
+	{
+		return;
+	}
+
 	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_HOURS_REG,&control);
+	dev->status = DS3231_ReadRegister(dev,DS3231_HOURS_REG,&control); //the hour itself is live, convert it to the new mode
 	if(dev->status == HAL_OK)
 	{
-		if (mode == Hour_24) //Set to 24-Hour Mode
-		{
-			if(DS_READ_BIT(control,DS3231_12_24) == 0) //If already in 24 hour mode
-			{
-				return;
-			}
-			else //convert current AM/PM hours to 24-Hour Format
-			{
-				uint8_t hours = BCDToDec(control &0x1F);
-				if(DS_READ_BIT(control,DS3231_AM_PM_20_HOUR) == 1)
-				{
-					hours = hours + 12;
-				}
-				DS_CLEAR_BIT(control,DS3231_AM_PM_20_HOUR);
-				DS_CLEAR_BIT(control,DS3231_12_24);
-				DS_CLEAR_BIT(control,7);
-				uint8_t new_hour = control | hours;
-				dev->status = DS3231_WriteRegister(dev,DS3231_HOURS_REG,&new_hour);
-				return;
-			}
-		}
-		else if(mode == Hour_12_AM_PM)//Set to 12-Hour AM/PM Mode
+		uint8_t new_hour = DS3231_EncodeHours(bit_12_24,DS3231_DecodeHours(control));
+		dev->status = DS3231_WriteRegister(dev,DS3231_HOURS_REG,&new_hour);
+		if(dev->status == HAL_OK)
 		{
-			if(DS_READ_BIT(control,DS3231_12_24) == 1) //If already in 12-Hour AM/PM mode
-			{
-				return;
-			}
-			else //convert current 24-Hour to AM/PM Format
-			{
-				uint8_t hours = BCDToDec(control &0x3F);
-
-				uint8_t pm = (hours >= 12);
-				uint8_t hours_pm = hours % 12;
-				if(hours_pm==0)
-				{
-					hours_pm = 12;
-				}
-
-				if(pm)
-				{
-					DS_SET_BIT(control,DS3231_AM_PM_20_HOUR);
-				}
-				else
-				{
-					DS_CLEAR_BIT(control,DS3231_AM_PM_20_HOUR);
-				}
-
-
-				DS_SET_BIT(control,DS3231_12_24);
-				DS_CLEAR_BIT(control,7);
-				uint8_t new_hour = control | hours;
-				dev->status = DS3231_WriteRegister(dev,DS3231_HOURS_REG,&new_hour);
-				return;
-			}
-
+			dev->shadow[DS3231_HOURS_REG] = bit_12_24;
 		}
+		return;
 	}
 	else
 	{
@@ -468,43 +355,67 @@ void DS3231_SetFullDate(DS3231* dev, uint8_t dow, uint8_t date, uint8_t month, u
 }
 
 
-//Alarm Functions
+//Date & Time Functions
+static void DS3231_DecodeDateTime(DS3231* dev, const uint8_t* regs) //registers 0x00-0x06 into time[] and date[]
+{
+	dev->time[0] = BCDToDec(regs[DS3231_SECONDS_REG] & 0x7F);
+	dev->time[1] = BCDToDec(regs[DS3231_MINUTES_REG] & 0x7F);
+	dev->time[2] = DS3231_DecodeHours(regs[DS3231_HOURS_REG]);
+	dev->date[0] = BCDToDec(regs[DS3231_DAY_OF_WEEK_REG] & 0x07);
+	dev->date[1] = BCDToDec(regs[DS3231_DATE_REG] & 0x3F);
+	dev->date[2] = BCDToDec(regs[DS3231_MONTH_REG] & 0x1F);
+	dev->date[3] = BCDToDec(regs[DS3231_YEAR_REG]);
+}
 
+static void DS3231_EncodeDateTime(uint8_t* regs, uint8_t mode, uint8_t sec, uint8_t min, uint8_t hour, uint8_t dow, uint8_t date, uint8_t month, uint8_t year) //century bit left 0
+{
+	regs[DS3231_SECONDS_REG] = DecToBCD(sec);
+	regs[DS3231_MINUTES_REG] = DecToBCD(min);
+	regs[DS3231_HOURS_REG] = DS3231_EncodeHours(mode,hour);
+	regs[DS3231_DAY_OF_WEEK_REG] = DecToBCD(dow & 0x07);
+	regs[DS3231_DATE_REG] = DecToBCD(date);
+	regs[DS3231_MONTH_REG] = DecToBCD(month);
+	regs[DS3231_YEAR_REG] = DecToBCD(year);
+}
 
-//Alarm 1 Functions
-void DS3231_Alarm1Enable(DS3231* dev, DS3231_States state)
+void DS3231_GetDateTime(DS3231* dev)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_REG, &control);
+	uint8_t regs[7]; //0x00-0x06 in one burst; the part latches them on START, so they can't tear across a rollover
+	dev->status = DS3231_ReadRegisters(dev,DS3231_SECONDS_REG,regs,sizeof(regs));
 	if(dev->status == HAL_OK)
 	{
-		if(state == Enabled)
+		DS3231_DecodeDateTime(dev,regs);
+		return;
+	}
+	else
+	{
+		for(uint8_t i = 0; i < sizeof(dev->time); i++)
 		{
-			if(DS_READ_BIT(control,DS3231_A1IE))
-			{
-				return;
-			}
-			else
-			{
-				DS_SET_BIT(control,DS3231_A1IE);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
-
+			dev->time[i] = 0;
 		}
-		else if(state == Disabled)
+		for(uint8_t i = 0; i < sizeof(dev->date); i++)
 		{
-			if(!DS_READ_BIT(control,DS3231_A1IE))
-			{
-				return;
-			}
-			else
-			{
-				DS_CLEAR_BIT(control,DS3231_A1IE);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+			dev->date[i] = 0;
 		}
+		return;
+	}
+}
+void DS3231_SetDateTime(DS3231* dev, uint8_t sec, uint8_t min, uint8_t hour, uint8_t dow, uint8_t date, uint8_t month, uint8_t year)
+{
+	uint8_t mode = DS3231_Shadow(dev,DS3231_HOURS_REG);
+	uint8_t century = 0;
+	if(dev->status == HAL_OK)
+	{
+		dev->status = DS3231_ReadRegister(dev,DS3231_MONTH_REG,&century); //century bit toggles on its own at year 99 -> 00, so it is read, not cached
+	}
+	if(dev->status == HAL_OK)
+	{
+		uint8_t regs[7];
+		DS3231_EncodeDateTime(regs,mode,sec,min,hour,dow,date,month,year);
+		regs[DS3231_MONTH_REG] |= century & (1U << DS3231_CENTURY);
+
+		dev->status = DS3231_WriteRegisters(dev,DS3231_SECONDS_REG,regs,sizeof(regs)); //one burst: the countdown chain restarts once, at the seconds write
+		return;
 	}
 	else
 	{
@@ -512,86 +423,180 @@ void DS3231_Alarm1Enable(DS3231* dev, DS3231_States state)
 	}
 }
 
-uint8_t DS3231_IsAlarm1FlagSet(DS3231* dev)
+
+//Calendar Functions
+#define DS3231_SWAR_LOW 0x000F0F0F0F0F0F0FULL //low nibble of each of the 7 register bytes
+
+static uint32_t DS3231_DaysFromCivil(uint32_t year, uint32_t mon, uint32_t mday) //days since 1970-01-01; years run from March so the leap day comes last
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG,&control);
-	return (DS_READ_BIT(control,DS3231_A1F));
+	year -= mon <= 2;
+	uint32_t era = year / 400;
+	uint32_t yoe = year - era * 400; //0-399
+	uint32_t doy = (153 * ((mon + 9) % 12) + 2) / 5 + mday - 1; //0-365, from 1 March
+	uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy; //0-146096
+	return era * 146097 + doe - 719468; //719468: 0000-03-01 to 1970-01-01
 }
 
-void DS3231_SetAlarm1Mode(DS3231* dev,DS3231_Alarmmode1 mode)
+void DS3231_DecodeBlock(const uint8_t* regs, DS3231_DateTime* dt)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_SECONDS_REG,&control);
-	control = control | DS_READ_BIT(mode,0) << DS3231_A1M1; //Insert A1M1 bit
-	if(dev->status == HAL_OK)
+	uint8_t hours = regs[DS3231_HOURS_REG];
+	uint8_t h12 = DS_READ_BIT(hours,DS3231_12_24);
+	uint64_t bcd = 0;
+	for(uint8_t i = 0; i < 7; i++)
+	{
+		bcd |= (uint64_t)regs[i] << (8 * i);
+	}
+	bcd &= 0x00FF1F3F073F7F7FULL & ~((uint64_t)h12 << 21); //control bits off; in 12 hour mode AM/PM off too
+	bcd = (bcd & DS3231_SWAR_LOW) + ((bcd >> 4) & DS3231_SWAR_LOW) * 10; //tens * 10 stays below 100, so no byte carries into the next
+
+	uint8_t hour = (uint8_t)(bcd >> 16);
+	dt->sec = (uint8_t)bcd;
+	dt->min = (uint8_t)(bcd >> 8);
+	dt->hour = h12 ? hour % 12 + 12 * DS_READ_BIT(hours,DS3231_AM_PM_20_HOUR) : hour;
+	dt->mday = (uint8_t)(bcd >> 32);
+	dt->mon = (uint8_t)(bcd >> 40);
+	dt->year = 2000 + 100 * DS_READ_BIT(regs[DS3231_MONTH_REG],DS3231_CENTURY) + (uint8_t)(bcd >> 48);
+	uint32_t days = DS3231_DaysFromCivil(dt->year,dt->mon,dt->mday);
+	dt->wday = (days + 4) % 7; //1970-01-01 was a Thursday
+	dt->yday = days - DS3231_DaysFromCivil(dt->year,1,1);
+}
+
+void DS3231_EncodeBlock(uint8_t* regs, const DS3231_DateTime* dt, uint8_t mode)
+{
+	DS3231_EncodeDateTime(regs,mode,dt->sec,dt->min,dt->hour,dt->wday + 1,dt->mday,dt->mon,dt->year % 100);
+	if(dt->year >= 2100)
 	{
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_SECONDS_REG,&control);
+		DS_SET_BIT(regs[DS3231_MONTH_REG],DS3231_CENTURY);
+	}
+}
 
-		dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_MINUTES_REG,&control);
-		control = control | DS_READ_BIT(mode,1) << DS3231_A1M2; //Insert A1M2 bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_MINUTES_REG,&control);
+int64_t DS3231_DateTimeToEpoch(DS3231_DateTime* dt)
+{
+	uint32_t days = DS3231_DaysFromCivil(dt->year,dt->mon,dt->mday);
+	dt->wday = (days + 4) % 7;
+	dt->yday = days - DS3231_DaysFromCivil(dt->year,1,1);
+	return (int64_t)days * 86400 + dt->hour * 3600 + dt->min * 60 + dt->sec;
+}
 
-		dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_HOURS_REG,&control);
-		control = control | DS_READ_BIT(mode,2) << DS3231_A1M3; //Insert A1M3 bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_HOURS_REG,&control);
+void DS3231_EpochToDateTime(int64_t epoch, DS3231_DateTime* dt)
+{
+	uint32_t days = (uint32_t)(epoch / 86400);
+	uint32_t secs = (uint32_t)(epoch % 86400);
+	dt->hour = secs / 3600;
+	dt->min = secs / 60 % 60;
+	dt->sec = secs % 60;
+	dt->wday = (days + 4) % 7;
+
+	uint32_t z = days + 719468; //inverse of DS3231_DaysFromCivil
+	uint32_t era = z / 146097;
+	uint32_t doe = z - era * 146097;
+	uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	uint32_t mp = (5 * doy + 2) / 153; //0 = March
+	dt->mday = doy - (153 * mp + 2) / 5 + 1;
+	dt->mon = mp < 10 ? mp + 3 : mp - 9;
+	dt->year = era * 400 + yoe + (dt->mon <= 2);
+	dt->yday = days - DS3231_DaysFromCivil(dt->year,1,1);
+}
 
-		dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_DAY_DATE_REG,&control);
-		control = control | (DS_READ_BIT(mode,3) << DS3231_A1M4) | mode & 0x80; //Insert A1M4 & DY/DT bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_DAY_DATE_REG,&control);
-		return;
+int64_t DS3231_BlockToEpoch(const uint8_t* regs)
+{
+	DS3231_DateTime dt;
+	DS3231_DecodeBlock(regs,&dt);
+	return DS3231_DateTimeToEpoch(&dt);
+}
 
-	}
-	else
-	{
-		return;
-	}
+void DS3231_EpochToBlock(int64_t epoch, uint8_t* regs, uint8_t mode)
+{
+	DS3231_DateTime dt;
+	DS3231_EpochToDateTime(epoch,&dt);
+	DS3231_EncodeBlock(regs,&dt,mode);
 }
 
-void DS3231_ClearAlarm1Flag(DS3231*dev)
+int64_t DS3231_GetEpoch(DS3231* dev)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG,&control);
+	uint8_t regs[7];
+	dev->status = DS3231_ReadRegisters(dev,DS3231_SECONDS_REG,regs,sizeof(regs));
 	if(dev->status == HAL_OK)
 	{
-		control = control & 0xFE;
-		DS_CLEAR_BIT(control,DS3231_A1F);
-		dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_STATUS_REG,&control);
-		return;
+		DS3231_DecodeDateTime(dev,regs);
+		return DS3231_BlockToEpoch(regs);
 	}
 	else
 	{
-		return;
+		return 0;
 	}
 }
 
-void DS3231_SetAlarm1Seconds(DS3231* dev, uint8_t sec)
+void DS3231_SetEpoch(DS3231* dev, int64_t epoch)
 {
-	uint8_t conv = DecToBCD(sec & 0x7F);
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_MINUTES_REG,&control);
+	uint8_t mode = DS3231_Shadow(dev,DS3231_HOURS_REG);
 	if(dev->status == HAL_OK)
 	{
-		uint8_t sec = (control & 0x80) | conv; //preserve Alarm Bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_MINUTES_REG,&sec);
+		uint8_t regs[7];
+		DS3231_EpochToBlock(epoch,regs,mode); //century bit from the epoch, so no read first
+		dev->status = DS3231_WriteRegisters(dev,DS3231_SECONDS_REG,regs,sizeof(regs));
 		return;
 	}
 	else
 	{
 		return;
 	}
+}
+
+
+//Alarm Functions
 
+
+//Alarm 1 Functions
+void DS3231_Alarm1Enable(DS3231* dev, DS3231_States state)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_REG,(1U << DS3231_A1IE),(state == Enabled) ? (1U << DS3231_A1IE) : 0);
+	return;
 }
 
-void DS3231_SetAlarm1Minutes(DS3231* dev, uint8_t min)
+uint8_t DS3231_IsAlarm1FlagSet(DS3231* dev)
 {
-	uint8_t conv = DecToBCD(min & 0x7F);
 	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_MINUTES_REG,&control);
+	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG,&control);
+	return (DS_READ_BIT(control,DS3231_A1F));
+}
+
+void DS3231_SetAlarm1Mode(DS3231* dev,DS3231_Alarmmode1 mode)
+{
+	static const uint8_t masks[4] = {0x80, 0x80, 0x80, 0xC0}; //A1Mx bits, DY/DT in the day/date register
+	uint8_t values[4] = {(uint8_t)(DS_READ_BIT(mode,0) << DS3231_A1M1),
+			(uint8_t)(DS_READ_BIT(mode,1) << DS3231_A1M2),
+			(uint8_t)(DS_READ_BIT(mode,2) << DS3231_A1M3),
+			(uint8_t)((DS_READ_BIT(mode,3) << DS3231_A1M4) | ((mode & 0x80) >> 1))}; //DY/DT is bit 7 of the enum, bit 6 of the register
+	dev->status = DS3231_UpdateRegisters(dev,DS3231_ALARM1_SECONDS_REG,masks,values,4); //one burst over the registers that change
+	return;
+}
+
+void DS3231_ClearAlarm1Flag(DS3231* dev)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_STATUS_REG,(1U << DS3231_A1F),0); //flags are volatile, so this always writes
+	return;
+}
+
+void DS3231_SetAlarm1Seconds(DS3231* dev, uint8_t sec)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_ALARM1_SECONDS_REG,0x7F,DecToBCD(sec)); //preserve Alarm Bit
+	return;
+}
+
+void DS3231_SetAlarm1Minutes(DS3231* dev, uint8_t min)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_ALARM1_MINUTES_REG,0x7F,DecToBCD(min)); //preserve Alarm Bit
+	return;
+}
+
+void DS3231_SetAlarm1Hours(DS3231* dev, uint8_t hour)
+{
+	uint8_t control = DS3231_Shadow(dev,DS3231_ALARM1_HOURS_REG);
 	if(dev->status == HAL_OK)
 	{
-		uint8_t min = (control & 0x80) | conv; //preserve Alarm Bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_MINUTES_REG,&min);
+		dev->status = DS3231_UpdateBits(dev,DS3231_ALARM1_HOURS_REG,0x7F,DS3231_EncodeHours(control,hour)); //preserves A1M3, keeps the 12/24 mode
 		return;
 	}
 	else
@@ -600,47 +605,15 @@ void DS3231_SetAlarm1Minutes(DS3231* dev, uint8_t min)
 	}
 }
 
-void DS3231_SetAlarm1Hours(DS3231* dev, uint8_t hour)
+void DS3231_SetAlarm1HourMode(DS3231* dev, DS3231_HourMode mode)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_HOURS_REG,&control);
-
-	uint8_t time = 0;
-
+	uint8_t control = DS3231_Shadow(dev,DS3231_ALARM1_HOURS_REG);
 	if(dev->status == HAL_OK)
 	{
-		uint8_t bit_12_24 = DS_READ_BIT(control,DS3231_12_24);
-		if(bit_12_24 == 1) //if 12/24 bit is set (12-Hour Mode/ AM/PM already enabled)
-		{
-			uint8_t bits_alarm_12 = control & 0xE0; //preserves A1M3 & 12/24 bit & AM/PM bit
-
-			uint8_t pm = (hour >= 12);
-			uint8_t hours_pm = hour % 12;
-			if(hours_pm==0)
-			{
-				hours_pm = 12;
-			}
-
-			if(pm)
-			{
-				DS_SET_BIT(bits_alarm_12,DS3231_AM_PM_20_HOUR);
-			}
-
-			uint8_t conv = DecToBCD(hours_pm & 0x1F);
-			time = bits_alarm_12 | conv;
-		}
-		else //if 12_24 bit is not set (24-Hour Mode already enabled)
-		{
-			uint8_t bits_alarm_24 = control & 0xC0;//preserves A1M3 & 12/24 bit
-
-			uint8_t conv = DecToBCD(hour & 0x3F);
-
-			time = bits_alarm_24 | conv;
-		}
-
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_HOURS_REG,&time);
+		uint8_t bit_12_24 = (mode == Hour_12_AM_PM) << DS3231_12_24;
+		uint8_t new_hour = DS3231_EncodeHours(bit_12_24,DS3231_DecodeHours(control & 0x7F)); //same hour in the new mode
+		dev->status = DS3231_UpdateBits(dev,DS3231_ALARM1_HOURS_REG,0x7F,new_hour); //no bus traffic if already in that mode
 		return;
-
 	}
 	else
 	{
@@ -648,66 +621,61 @@ void DS3231_SetAlarm1Hours(DS3231* dev, uint8_t hour)
 	}
 }
 
-void DS3231_SetAlarm1HourMode(DS3231* dev, DS3231_HourMode mode)
+void DS3231_SetAlarm1DayOfWeek(DS3231* dev, uint8_t dow)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_HOURS_REG,&control);
-	if(dev->status == HAL_OK)
-	{
-		if (mode == Hour_24) //Set to 24-Hour Mode
-		{
-			if(DS_READ_BIT(control,DS3231_12_24) == 0) //If already in 24 hour mode
-			{
-				return;
-			}
-			else //convert current AM/PM hours to 24-Hour Format
-			{
-				uint8_t hours = BCDToDec(control &0x1F);
-				if(DS_READ_BIT(control,DS3231_AM_PM_20_HOUR) == 1)
-				{
-					hours = hours + 12;
-				}
-				DS_CLEAR_BIT(control,DS3231_AM_PM_20_HOUR);
-				DS_CLEAR_BIT(control,DS3231_12_24);
-				uint8_t new_hour = control | hours;
-				dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_HOURS_REG,&new_hour);
-				return;
-			}
-		}
-		else if(mode == Hour_12_AM_PM)//Set to 12-Hour AM/PM Mode
-		{
-			if(DS_READ_BIT(control,DS3231_12_24) == 1) //If already in 12-Hour AM/PM mode
-			{
-				return;
-			}
-			else //convert current 24-Hour to AM/PM Format
-			{
-				uint8_t hours = BCDToDec(control &0x3F);
+	dev->status = DS3231_UpdateBits(dev,DS3231_ALARM1_DAY_DATE_REG,0x3F,DecToBCD(dow & 0x0F)); //preserve Alarm Bit & DY/DT-Bit
+	return;
+}
 
-				uint8_t pm = (hours >= 12);
-				uint8_t hours_pm = hours % 12;
-				if(hours_pm==0)
-				{
-					hours_pm = 12;
-				}
+void DS3231_SetAlarm1Date(DS3231* dev, uint8_t date)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_ALARM1_DAY_DATE_REG,0x3F,DecToBCD(date & 0x3F)); //preserve Alarm Bit & DY/DT-Bit
+	return;
+}
 
-				if(pm)
-				{
-					DS_SET_BIT(control,DS3231_AM_PM_20_HOUR);
-				}
-				else
-				{
-					DS_CLEAR_BIT(control,DS3231_AM_PM_20_HOUR);
-				}
+//Alarm 2 Functions
+void DS3231_Alarm2Enable(DS3231* dev, DS3231_States state)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_REG,(1U << DS3231_A2IE),(state == Enabled) ? (1U << DS3231_A2IE) : 0);
+	return;
+}
 
+uint8_t DS3231_IsAlarm2FlagSet(DS3231* dev)
+{
+	uint8_t control;
+	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG,&control);
+	return (DS_READ_BIT(control,DS3231_A2F));
+}
 
-				DS_SET_BIT(control,DS3231_12_24);
-				uint8_t new_hour = control | hours;
-				dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_HOURS_REG,&new_hour);
-				return;
-			}
+void DS3231_SetAlarm2Mode(DS3231* dev,DS3231_Alarmmode2 mode)
+{
+	static const uint8_t masks[3] = {0x80, 0x80, 0xC0}; //A2Mx bits, DY/DT in the day/date register
+	uint8_t values[3] = {(uint8_t)(DS_READ_BIT(mode,0) << DS3231_A2M2),
+			(uint8_t)(DS_READ_BIT(mode,1) << DS3231_A2M3),
+			(uint8_t)((DS_READ_BIT(mode,2) << DS3231_A2M4) | ((mode & 0x80) >> 1))}; //DY/DT is bit 7 of the enum, bit 6 of the register
+	dev->status = DS3231_UpdateRegisters(dev,DS3231_ALARM2_MINUTES_REG,masks,values,3); //one burst over the registers that change
+	return;
+}
 
-		}
+void DS3231_ClearAlarm2Flag(DS3231* dev)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_STATUS_REG,(1U << DS3231_A2F),0); //flags are volatile, so this always writes
+	return;
+}
+
+void DS3231_SetAlarm2Minutes(DS3231* dev, uint8_t min)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_ALARM2_MINUTES_REG,0x7F,DecToBCD(min)); //preserve Alarm Bit
+	return;
+}
+
+void DS3231_SetAlarm2Hours(DS3231* dev, uint8_t hour)
+{
+	uint8_t control = DS3231_Shadow(dev,DS3231_ALARM2_HOURS_REG);
+	if(dev->status == HAL_OK)
+	{
+		dev->status = DS3231_UpdateBits(dev,DS3231_ALARM2_HOURS_REG,0x7F,DS3231_EncodeHours(control,hour)); //preserves A2M3, keeps the 12/24 mode
+		return;
 	}
 	else
 	{
@@ -715,15 +683,14 @@ void DS3231_SetAlarm1HourMode(DS3231* dev, DS3231_HourMode mode)
 	}
 }
 
-void DS3231_SetAlarm1DayOfWeek(DS3231* dev, uint8_t dow)
+void DS3231_SetAlarm2HourMode(DS3231* dev, DS3231_HourMode mode)
 {
-	uint8_t conv = DecToBCD(dow & 0x0F);
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_DAY_DATE_REG,&control);
+	uint8_t control = DS3231_Shadow(dev,DS3231_ALARM2_HOURS_REG);
 	if(dev->status == HAL_OK)
 	{
-		uint8_t dow = (control & 0xC0) | conv; //preserve Alarm Bit & DY/DT-Bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_DAY_DATE_REG,&dow);
+		uint8_t bit_12_24 = (mode == Hour_12_AM_PM) << DS3231_12_24;
+		uint8_t new_hour = DS3231_EncodeHours(bit_12_24,DS3231_DecodeHours(control & 0x7F)); //same hour in the new mode
+		dev->status = DS3231_UpdateBits(dev,DS3231_ALARM2_HOURS_REG,0x7F,new_hour); //no bus traffic if already in that mode
 		return;
 	}
 	else
@@ -732,637 +699,996 @@ void DS3231_SetAlarm1DayOfWeek(DS3231* dev, uint8_t dow)
 	}
 }
 
-void DS3231_SetAlarm1Date(DS3231* dev, uint8_t date)
+void DS3231_SetAlarm2DayOfWeek(DS3231* dev, uint8_t dow)
 {
-	uint8_t conv = DecToBCD(date & 0x3F);
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_DAY_DATE_REG,&control);
-	if(dev->status == HAL_OK)
+	dev->status = DS3231_UpdateBits(dev,DS3231_ALARM2_DAY_DATE_REG,0x3F,DecToBCD(dow & 0x0F)); //preserve Alarm Bit & DY/DT-Bit
+	return;
+}
+
+void DS3231_SetAlarm2Date(DS3231* dev, uint8_t date)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_ALARM2_DAY_DATE_REG,0x3F,DecToBCD(date & 0x3F)); //preserve Alarm Bit & DY/DT-Bit
+	return;
+}
+
+
+//Configuration Functions
+void DS3231_GetConfig(DS3231* dev, DS3231_Config* config)
+{
+	uint8_t control = DS3231_Shadow(dev,DS3231_CONTROL_REG);
+	uint8_t status = dev->shadow[DS3231_CONTROL_STATUS_REG]; //loaded together with control
+
+	config->oscillator = DS_READ_BIT(control,DS3231_EOSC) ? Disabled : Enabled; //EOSC is negated
+	config->bbsqw = DS_READ_BIT(control,DS3231_BBSQW) ? Enabled : Disabled;
+	config->rate = (DS3231_Rate)((control >> DS3231_RS_1) & 0x03);
+	config->interrupt = DS_READ_BIT(control,DS3231_INTCN) ? Enabled : Disabled;
+	config->alarm1 = DS_READ_BIT(control,DS3231_A1IE) ? Enabled : Disabled;
+	config->alarm2 = DS_READ_BIT(control,DS3231_A2IE) ? Enabled : Disabled;
+	config->out_32kHz = DS_READ_BIT(status,DS3231_EN32kHz) ? Enabled : Disabled;
+	config->clear_flags = 0;
+	return;
+}
+
+static void DS3231_ConfigBytes(const DS3231_Config* config, uint8_t* masks, uint8_t* values) //target bits for 0x0E-0x0F
+{
+	uint8_t flags = config->clear_flags & ((1U << DS3231_OSF) | (1U << DS3231_A2F) | (1U << DS3231_A1F));
+	masks[0] = (uint8_t)~(1U << DS3231_CONV);
+	masks[1] = (uint8_t)((1U << DS3231_EN32kHz) | flags);
+	values[0] = 0;
+	values[1] = 0; //flags to clear are written as 0
+
+	if(config->oscillator == Disabled)
 	{
-		uint8_t date = (control & 0xC0) | conv; //preserve Alarm Bit & DY/DT-Bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_DAY_DATE_REG,&date);
-		return;
+		DS_SET_BIT(values[0],DS3231_EOSC);
 	}
-	else
+	if(config->bbsqw == Enabled)
 	{
-		return;
+		DS_SET_BIT(values[0],DS3231_BBSQW);
 	}
+	values[0] |= (uint8_t)((config->rate & 0x03) << DS3231_RS_1);
+	if(config->interrupt == Enabled)
+	{
+		DS_SET_BIT(values[0],DS3231_INTCN);
+	}
+	if(config->alarm2 == Enabled)
+	{
+		DS_SET_BIT(values[0],DS3231_A2IE);
+	}
+	if(config->alarm1 == Enabled)
+	{
+		DS_SET_BIT(values[0],DS3231_A1IE);
+	}
+	if(config->out_32kHz == Enabled)
+	{
+		DS_SET_BIT(values[1],DS3231_EN32kHz);
+	}
+}
 
+void DS3231_ApplyConfig(DS3231* dev, const DS3231_Config* config)
+{
+	uint8_t masks[2];
+	uint8_t values[2];
+	DS3231_ConfigBytes(config,masks,values);
+	dev->status = DS3231_UpdateRegisters(dev,DS3231_CONTROL_REG,masks,values,sizeof(values)); //reads 0x02-0x0F first only if the shadow is not loaded
+	return;
 }
 
-//Alarm 2 Functions
-void DS3231_Alarm2Enable(DS3231* dev, DS3231_States state)
+void DS3231_OscillatorEnable(DS3231* dev, DS3231_States state)
 {
-	uint8_t control;
-		dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_REG, &control);
-		if(dev->status == HAL_OK)
-		{
-			if(state == Enabled)
-			{
-				if(DS_READ_BIT(control,DS3231_A2IE))
-				{
-					return;
-				}
-				else
-				{
-					DS_SET_BIT(control,DS3231_A2IE);
-					dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-					return;
-				}
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_REG,(1U << DS3231_EOSC),(state == Enabled) ? 0 : (1U << DS3231_EOSC)); //EOSC is negated
+	return;
+}
 
-			}
-			else if(state == Disabled)
-			{
-				if(!DS_READ_BIT(control,DS3231_A2IE))
-				{
-					return;
-				}
-				else
-				{
-					DS_CLEAR_BIT(control,DS3231_A2IE);
-					dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-					return;
-				}
-			}
-		}
-		else
-		{
-			return;
-		}
+uint8_t DS3231_IsOscillatorSet(DS3231* dev)
+{
+	uint8_t control = DS3231_Shadow(dev,DS3231_CONTROL_REG);
+	return (!DS_READ_BIT(control,DS3231_EOSC)); //returns 1 for Enabled Oscillator (on Power On) (EOSC is negated)
 }
 
-uint8_t DS3231_IsAlarm2FlagSet(DS3231* dev)
+void DS3231_BBSQWEnable(DS3231* dev, DS3231_States state)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG,&control);
-	return (DS_READ_BIT(control,DS3231_A2F));
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_REG,(1U << DS3231_BBSQW),(state == Enabled) ? (1U << DS3231_BBSQW) : 0);
+	return;
 }
 
-void DS3231_SetAlarm2Mode(DS3231* dev,DS3231_Alarmmode2 mode)
+uint8_t DS3231_IsBBSQWSet(DS3231* dev)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM2_MINUTES_REG,&control);
-	control = control | DS_READ_BIT(mode,0) << DS3231_A2M2; //Insert A2M2 bit
-	if(dev->status == HAL_OK)
-	{
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM2_MINUTES_REG,&control);
+	uint8_t control = DS3231_Shadow(dev,DS3231_CONTROL_REG);
+	return (DS_READ_BIT(control,DS3231_BBSQW)); //returns 1 for BBSQW = 1 (on Power On)
+}
 
-		dev->status = DS3231_ReadRegister(dev,DS3231_ALARM2_HOURS_REG,&control);
-		control = control | DS_READ_BIT(mode,1) << DS3231_A2M3; ///Insert A2M3 bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM2_HOURS_REG,&control);
+void DS3231_RateSelect(DS3231* dev, DS3231_Rate rate)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_REG,(1U << DS3231_RS_2) | (1U << DS3231_RS_1),(uint8_t)(rate << DS3231_RS_1)); //RS2:RS1 follow the enum order
+	return;
+}
 
-		dev->status = DS3231_ReadRegister(dev,DS3231_ALARM2_DAY_DATE_REG,&control);
-		control = control | (DS_READ_BIT(mode,2) << DS3231_A2M4) | mode & 0x80; //Insert A2M4 bit & DY/DT
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM2_DAY_DATE_REG,&control);
-		return;
+uint8_t DS3231_IsRateSelectSet(DS3231* dev)
+{
+	uint8_t control = DS3231_Shadow(dev,DS3231_CONTROL_REG);
+	return (DS_READ_BIT(control,DS3231_RS_2) && DS_READ_BIT(control,DS3231_RS_1)); //returns 1 for RS2 & RS1 = 1 (on Power On)
+}
 
-	}
-	else
+void DS3231_InterruptEnable(DS3231* dev, DS3231_States state)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_REG,(1U << DS3231_INTCN),(state == Enabled) ? (1U << DS3231_INTCN) : 0); //Enabled: AlarmInterrupt-Mode, Disabled: SQW-Mode
+	return;
+}
+
+uint8_t DS3231_IsInterruptSet(DS3231* dev)
+{
+	uint8_t control = DS3231_Shadow(dev,DS3231_CONTROL_REG);
+	return (DS_READ_BIT(control,DS3231_INTCN)); //returns 1 for INTCN = 1 (on Power On)
+}
+
+void DS3231_32kHzEnable(DS3231* dev, DS3231_States state)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_STATUS_REG,(1U << DS3231_EN32kHz),(state == Enabled) ? (1U << DS3231_EN32kHz) : 0);
+	return;
+}
+
+uint8_t DS3231_Is32kHzSet(DS3231* dev)
+{
+	uint8_t control = DS3231_Shadow(dev,DS3231_CONTROL_STATUS_REG);
+	return (DS_READ_BIT(control,DS3231_EN32kHz)); //returns 1 for EN32kHz = 1 (on Power On)
+}
+
+void DS3231_ClearOscillatorStoppedFlag(DS3231* dev)
+{
+	dev->status = DS3231_UpdateBits(dev,DS3231_CONTROL_STATUS_REG,(1U << DS3231_OSF),0); //flags are volatile, so this always writes
+	return;
+}
+
+uint8_t DS3231_IsOscillatorStoppedSet(DS3231* dev)
+{
+	uint8_t control;
+	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG, &control);
+	if(dev->status == HAL_OK && DS_READ_BIT(control,DS3231_OSF))
 	{
-		return;
+		dev->shadow_valid = 0; //oscillator stopped (power loss?): the registers may be back at their power-on values
 	}
+	return (DS_READ_BIT(control,DS3231_OSF)); //returns 1 for OSF = 1 (on Power On)
 }
 
-void DS3231_ClearAlarm2Flag(DS3231* dev)
+
+//Temperature Functions
+static int16_t DS3231_DecodeTemp(const uint8_t* temp) //0x11-0x12 to hundredths of degC
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG,&control);
+	int16_t quarters = (int16_t)((uint16_t)(temp[0] << 8) | temp[1]) / 64; //10 bit two's complement, 0.25 degC steps
+	return quarters * 25;
+}
+
+void DS3231_Get_Temp(DS3231* dev)
+{
+	uint8_t temp[2];
+	dev->status = DS3231_ReadRegisters(dev,DS3231_TEMPERATURE_MSB_REG,temp,sizeof(temp));
+
 	if(dev->status == HAL_OK)
 	{
-		control = control & 0xFD;
-		DS_CLEAR_BIT(control,DS3231_A2F);
-		dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_STATUS_REG,&control);
+		dev->temp = DS3231_DecodeTemp(temp);
 		return;
 	}
 	else
 	{
+		dev->temp = 0;
 		return;
 	}
 }
 
-void DS3231_SetAlarm2Minutes(DS3231* dev, uint8_t min)
-{
-	uint8_t conv = DecToBCD(min & 0x7F);
+void DS3231_Force_TempConversion(DS3231 *dev) {
 	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM2_MINUTES_REG,&control);
-	if(dev->status == HAL_OK)
-	{
-		uint8_t min = (control & 0x80) | conv; //preserve Alarm Bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM2_MINUTES_REG,&min);
+	dev->status = DS3231_ReadRegister(dev, DS3231_CONTROL_STATUS_REG, &control);
+	if (dev->status == HAL_OK) {
+		uint8_t bsy = DS_READ_BIT(control, DS3231_BSY);
+		if (bsy == 1) {
+			return;
+		} else {
+			dev->status = DS3231_UpdateBits(dev, DS3231_CONTROL_REG,
+					(1U << DS3231_CONV), (1U << DS3231_CONV));
+			return;
+		}
+	} else {
 		return;
 	}
+}
+
+//Shadow Register Functions
+static const uint8_t DS3231_Cached[DS3231_SHADOW_REGS] = { //bits that only change when the driver writes them
+	0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, //time and date: 12/24 mode only
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, //alarms
+	0xDF, 0x08 //control without CONV, status: EN32kHz only
+};
+
+static const uint8_t DS3231_Neutral[DS3231_SHADOW_REGS] = { //written to uncached bits nobody asked to change
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x83 //writing 1 to OSF, A2F and A1F leaves them as they are
+};
+
+HAL_StatusTypeDef DS3231_LoadShadow(DS3231* dev)
+{
+	uint8_t regs[DS3231_SHADOW_REGS - DS3231_HOURS_REG]; //0x02-0x0F in one burst
+	HAL_StatusTypeDef status = DS3231_ReadRegisters(dev,DS3231_HOURS_REG,regs,sizeof(regs));
+	if(status == HAL_OK)
+	{
+		for(uint8_t reg = 0; reg < DS3231_SHADOW_REGS; reg++)
+		{
+			uint8_t value = (reg >= DS3231_HOURS_REG) ? regs[reg - DS3231_HOURS_REG] : 0;
+			dev->shadow[reg] = (value & DS3231_Cached[reg]) | DS3231_Neutral[reg];
+		}
+		dev->shadow_valid = 1;
+	}
 	else
 	{
-		return;
+		dev->shadow_valid = 0;
 	}
+	return status;
 }
 
-void DS3231_SetAlarm2Hours(DS3231* dev, uint8_t hour)
+static uint8_t DS3231_Shadow(DS3231* dev, uint8_t reg) //cached bits of reg, loads the shadow first if needed
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM2_HOURS_REG,&control);
-
-	uint8_t time = 0;
+	dev->status = HAL_OK;
+	if(!dev->shadow_valid)
+	{
+		dev->status = DS3231_LoadShadow(dev);
+	}
+	return dev->shadow[reg] & DS3231_Cached[reg];
+}
 
-	if(dev->status == HAL_OK)
+static uint8_t DS3231_ShadowDiff(DS3231* dev, uint8_t reg, const uint8_t* mask, const uint8_t* value, uint8_t length, uint8_t* regs, uint8_t* first, uint8_t* last) //target bytes into regs; 0 if nothing needs writing
+{
+	*first = length;
+	*last = 0;
+	for(uint8_t i = 0; i < length; i++)
 	{
-		uint8_t bit_12_24 = DS_READ_BIT(control,DS3231_12_24);
-		if(bit_12_24 == 1) //if 12/24 bit is set (12-Hour Mode/ AM/PM already enabled)
+		uint8_t r = reg + i;
+		regs[i] = (dev->shadow[r] & ~mask[i]) | (value[i] & mask[i]);
+		if(((regs[i] ^ dev->shadow[r]) & DS3231_Cached[r]) || (mask[i] & ~DS3231_Cached[r])) //cached bit changes or volatile bit touched
 		{
-			uint8_t bits_alarm_12 = control & 0xE0; //preserves A2M3 & 12/24 bit & AM/PM bit
-
-			uint8_t pm = (hour >= 12);
-			uint8_t hours_pm = hour % 12;
-			if(hours_pm==0)
-			{
-				hours_pm = 12;
-			}
-
-			if(pm)
+			if(*first == length)
 			{
-				DS_SET_BIT(bits_alarm_12,DS3231_AM_PM_20_HOUR);
+				*first = i;
 			}
-
-			uint8_t conv = DecToBCD(hours_pm & 0x1F);
-			time = bits_alarm_12 | conv;
+			*last = i;
 		}
-		else //if 12_24 bit is not set (24-Hour Mode already enabled)
-		{
-			uint8_t bits_alarm_24 = control & 0xC0;//preserves A2M3 & 12/24 bit
+	}
+	return *first != length;
+}
 
-			uint8_t conv = DecToBCD(hour & 0x3F);
+static void DS3231_ShadowCommit(DS3231* dev, uint8_t reg, const uint8_t* regs, uint8_t first, uint8_t last) //regs[first..last] reached the part
+{
+	for(uint8_t i = first; i <= last; i++)
+	{
+		dev->shadow[reg + i] = (regs[i] & DS3231_Cached[reg + i]) | DS3231_Neutral[reg + i];
+	}
+}
 
-			time = bits_alarm_24 | conv;
+HAL_StatusTypeDef DS3231_UpdateRegisters(DS3231* dev, uint8_t reg, const uint8_t* mask, const uint8_t* value, uint8_t length)
+{
+	if(reg < DS3231_ALARM1_SECONDS_REG || reg + length > DS3231_SHADOW_REGS || length == 0)
+	{
+		return HAL_ERROR;
+	}
+	if(!dev->shadow_valid)
+	{
+		HAL_StatusTypeDef status = DS3231_LoadShadow(dev);
+		if(status != HAL_OK)
+		{
+			return status;
 		}
+	}
 
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM2_HOURS_REG,&time);
-		return;
+	uint8_t regs[DS3231_SHADOW_REGS];
+	uint8_t first;
+	uint8_t last;
+	if(!DS3231_ShadowDiff(dev,reg,mask,value,length,regs,&first,&last)) //nothing changes, no bus traffic
+	{
+		return HAL_OK;
+	}
 
+	HAL_StatusTypeDef status = DS3231_WriteRegisters(dev,reg + first,&regs[first],last - first + 1); //one burst over the changed span
+	if(status == HAL_OK)
+	{
+		DS3231_ShadowCommit(dev,reg,regs,first,last);
 	}
 	else
 	{
-		return;
+		dev->shadow_valid = 0; //unknown what reached the part
 	}
+	return status;
 }
 
-void DS3231_SetAlarm2HourMode(DS3231* dev, DS3231_HourMode mode)
+HAL_StatusTypeDef DS3231_UpdateBits(DS3231* dev, uint8_t reg, uint8_t mask, uint8_t value)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM2_HOURS_REG,&control);
-	if(dev->status == HAL_OK)
+	return DS3231_UpdateRegisters(dev,reg,&mask,&value,1);
+}
+
+
+//Asynchronous Functions
+#ifdef DS3231_ASYNC_DMA
+#define DS3231_MEM_READ_ASYNC HAL_I2C_Mem_Read_DMA
+#define DS3231_MEM_WRITE_ASYNC HAL_I2C_Mem_Write_DMA
+#else
+#define DS3231_MEM_READ_ASYNC HAL_I2C_Mem_Read_IT
+#define DS3231_MEM_WRITE_ASYNC HAL_I2C_Mem_Write_IT
+#endif
+
+static HAL_StatusTypeDef DS3231_AsyncRead(DS3231* dev, uint8_t reg, uint8_t* data, uint8_t length)
+{
+	HAL_StatusTypeDef status = DS3231_MEM_READ_ASYNC(dev->i2cHandle, DS3231_I2C_ADDRESS,reg, I2C_MEMADD_SIZE_8BIT,data,length);
+	return (status == HAL_OK) ? HAL_BUSY : HAL_ERROR; //HAL_BUSY: on the bus, the completion callback carries on
+}
+
+static HAL_StatusTypeDef DS3231_AsyncWrite(DS3231* dev, uint8_t reg, uint8_t* data, uint8_t length)
+{
+	HAL_StatusTypeDef status = DS3231_MEM_WRITE_ASYNC(dev->i2cHandle, DS3231_I2C_ADDRESS,reg, I2C_MEMADD_SIZE_8BIT,data,length);
+	return (status == HAL_OK) ? HAL_BUSY : HAL_ERROR;
+}
+
+static HAL_StatusTypeDef DS3231_AsyncNext(DS3231* dev, DS3231_Request* req) //takes in the transfer that just finished (req->step of them so far), starts the next one
+{
+	switch(req->type)
 	{
-		if (mode == Hour_24) //Set to 24-Hour Mode
-		{
-			if(DS_READ_BIT(control,DS3231_12_24) == 0) //If already in 24 hour mode
+		case Request_GetDateTime:
+			if(req->step == 0)
 			{
-				return;
+				return DS3231_AsyncRead(dev,DS3231_SECONDS_REG,req->data,7);
 			}
-			else //convert current AM/PM hours to 24-Hour Format
+			DS3231_DecodeDateTime(dev,req->data);
+			return HAL_OK;
+
+		case Request_SetDateTime:
+			if(req->step == 0) //century bit toggles on its own, read it right before the write
 			{
-				uint8_t hours = BCDToDec(control &0x1F);
-				if(DS_READ_BIT(control,DS3231_AM_PM_20_HOUR) == 1)
-				{
-					hours = hours + 12;
-				}
-				DS_CLEAR_BIT(control,DS3231_AM_PM_20_HOUR);
-				DS_CLEAR_BIT(control,DS3231_12_24);
-				uint8_t new_hour = control | hours;
-				dev->status = DS3231_WriteRegister(dev,DS3231_ALARM2_HOURS_REG,&new_hour);
-				return;
+				return DS3231_AsyncRead(dev,DS3231_MONTH_REG,&req->scratch,1);
 			}
-		}
-		else if(mode == Hour_12_AM_PM)//Set to 12-Hour AM/PM Mode
-		{
-			if(DS_READ_BIT(control,DS3231_12_24) == 1) //If already in 12-Hour AM/PM mode
+			if(req->step == 1)
 			{
-				return;
+				req->data[DS3231_MONTH_REG] |= req->scratch & (1U << DS3231_CENTURY);
+				return DS3231_AsyncWrite(dev,DS3231_SECONDS_REG,req->data,7);
 			}
-			else //convert current 24-Hour to AM/PM Format
+			return HAL_OK;
+
+		case Request_Get_Temp:
+			if(req->step == 0)
 			{
-				uint8_t hours = BCDToDec(control &0x3F);
+				return DS3231_AsyncRead(dev,DS3231_TEMPERATURE_MSB_REG,req->data,2);
+			}
+			dev->temp = DS3231_DecodeTemp(req->data);
+			return HAL_OK;
 
-				uint8_t pm = (hours >= 12);
-				uint8_t hours_pm = hours % 12;
-				if(hours_pm==0)
+		case Request_ApplyConfig: //data[0..1] target values, data[2..3] bytes to write
+			if(req->step == 0)
+			{
+				if(!DS3231_ShadowDiff(dev,DS3231_CONTROL_REG,req->masks,req->data,2,&req->data[2],&req->first,&req->last))
 				{
-					hours_pm = 12;
+					return HAL_OK; //nothing changes, no bus traffic
 				}
+				return DS3231_AsyncWrite(dev,DS3231_CONTROL_REG + req->first,&req->data[2 + req->first],req->last - req->first + 1);
+			}
+			DS3231_ShadowCommit(dev,DS3231_CONTROL_REG,&req->data[2],req->first,req->last);
+			return HAL_OK;
+	}
+	return HAL_ERROR;
+}
 
-				if(pm)
-				{
-					DS_SET_BIT(control,DS3231_AM_PM_20_HOUR);
-				}
-				else
-				{
-					DS_CLEAR_BIT(control,DS3231_AM_PM_20_HOUR);
-				}
+static void DS3231_AsyncFinish(DS3231_Async* async, HAL_StatusTypeDef status) //retires the request at the head of the queue
+{
+	DS3231_Request* req = &async->queue[async->head];
+	DS3231_Callback callback = req->callback;
+	uint32_t token = req->token;
 
+	if(status != HAL_OK && req->type == Request_ApplyConfig)
+	{
+		async->dev->shadow_valid = 0; //unknown what reached the part
+	}
+	async->dev->status = status;
+	async->result[token % DS3231_ASYNC_QUEUE] = status;
+	async->done_token = token;
+	async->head = (async->head + 1) % DS3231_ASYNC_QUEUE;
+	async->count--;
 
-				DS_SET_BIT(control,DS3231_12_24);
-				uint8_t new_hour = control | hours;
-				dev->status = DS3231_WriteRegister(dev,DS3231_ALARM2_HOURS_REG,&new_hour);
-				return;
-			}
+	if(callback)
+	{
+		callback(async->dev,token,status);
+	}
+}
 
+static void DS3231_AsyncRun(DS3231_Async* async) //with interrupts off or from the completion interrupt: runs the queue until a transfer is on the bus
+{
+	while(async->count > 0)
+	{
+		HAL_StatusTypeDef status = DS3231_AsyncNext(async->dev,&async->queue[async->head]);
+		if(status == HAL_BUSY)
+		{
+			return;
 		}
+		DS3231_AsyncFinish(async,status);
 	}
-	else
+	async->busy = 0;
+}
+
+static uint32_t DS3231_AsyncSubmit(DS3231_Async* async, DS3231_Request* req)
+{
+	uint32_t token = 0;
+	DS3231_LOCK();
+	if(async->count < DS3231_ASYNC_QUEUE)
 	{
-		return;
+		async->next_token++;
+		if(async->next_token == 0) //0 means queue full
+		{
+			async->next_token++;
+		}
+		token = async->next_token;
+		req->token = token;
+		req->step = 0;
+		async->queue[(async->head + async->count) % DS3231_ASYNC_QUEUE] = *req;
+		async->count++;
+		if(!async->busy)
+		{
+			async->busy = 1;
+			DS3231_AsyncRun(async);
+		}
 	}
+	DS3231_UNLOCK();
+	return token;
 }
 
-void DS3231_SetAlarm2DayOfWeek(DS3231* dev, uint8_t dow)
+void DS3231_AsyncInit(DS3231_Async* async, DS3231* dev)
 {
-	uint8_t conv = DecToBCD(dow & 0x0F);
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM2_DAY_DATE_REG,&control);
-	if(dev->status == HAL_OK)
+	async->dev = dev;
+	async->head = 0;
+	async->count = 0;
+	async->busy = 0;
+	async->next_token = 0;
+	async->done_token = 0;
+	for(uint8_t i = 0; i < DS3231_ASYNC_QUEUE; i++)
+	{
+		async->result[i] = HAL_OK;
+	}
+}
+
+uint32_t DS3231_GetDateTimeAsync(DS3231_Async* async, DS3231_Callback callback)
+{
+	DS3231_Request req;
+	req.type = Request_GetDateTime;
+	req.callback = callback;
+	return DS3231_AsyncSubmit(async,&req);
+}
+
+uint32_t DS3231_SetDateTimeAsync(DS3231_Async* async, uint8_t sec, uint8_t min, uint8_t hour, uint8_t dow, uint8_t date, uint8_t month, uint8_t year, DS3231_Callback callback)
+{
+	DS3231* dev = async->dev;
+	if(!dev->shadow_valid) //hour mode comes from the shadow: DS3231_Init first
+	{
+		return 0;
+	}
+	DS3231_Request req;
+	req.type = Request_SetDateTime;
+	req.callback = callback;
+	DS3231_EncodeDateTime(req.data,dev->shadow[DS3231_HOURS_REG] & DS3231_Cached[DS3231_HOURS_REG],sec,min,hour,dow,date,month,year);
+	return DS3231_AsyncSubmit(async,&req);
+}
+
+uint32_t DS3231_Get_TempAsync(DS3231_Async* async, DS3231_Callback callback)
+{
+	DS3231_Request req;
+	req.type = Request_Get_Temp;
+	req.callback = callback;
+	return DS3231_AsyncSubmit(async,&req);
+}
+
+uint32_t DS3231_ApplyConfigAsync(DS3231_Async* async, const DS3231_Config* config, DS3231_Callback callback)
+{
+	if(!async->dev->shadow_valid) //compared against the shadow when it reaches the head of the queue
+	{
+		return 0;
+	}
+	DS3231_Request req;
+	req.type = Request_ApplyConfig;
+	req.callback = callback;
+	DS3231_ConfigBytes(config,req.masks,req.data);
+	return DS3231_AsyncSubmit(async,&req);
+}
+
+HAL_StatusTypeDef DS3231_AsyncPoll(DS3231_Async* async, uint32_t token)
+{
+	HAL_StatusTypeDef status = HAL_BUSY;
+	DS3231_LOCK();
+	if(token == 0)
+	{
+		status = HAL_ERROR;
+	}
+	else if((int32_t)(async->done_token - token) >= 0) //requests finish in submission order
+	{
+		status = async->result[token % DS3231_ASYNC_QUEUE];
+	}
+	DS3231_UNLOCK();
+	return status;
+}
+
+void DS3231_AsyncTransferDone(DS3231_Async* async, I2C_HandleTypeDef* hi2c, HAL_StatusTypeDef result)
+{
+	if(hi2c != async->dev->i2cHandle || !async->busy) //another device on the same HAL callbacks
 	{
-		uint8_t dow = (control & 0xC0) | conv; //preserve Alarm Bit & DY/DT-Bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM2_DAY_DATE_REG,&dow);
 		return;
 	}
+	if(result == HAL_OK)
+	{
+		async->queue[async->head].step++;
+	}
 	else
 	{
-		return;
+		DS3231_AsyncFinish(async,result);
 	}
+	DS3231_AsyncRun(async);
 }
 
-void DS3231_SetAlarm2Date(DS3231* dev, uint8_t date)
+
+//Software Clock Functions
+static uint8_t DS3231_DaysInMonth(uint8_t month, uint8_t year) //as the part counts: every year divisible by 4 is a leap year
 {
-	uint8_t conv = DecToBCD(date & 0x3F);
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_ALARM1_DAY_DATE_REG,&control);
-	if(dev->status == HAL_OK)
+	static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	if(month == 2 && (year % 4) == 0)
+	{
+		return 29;
+	}
+	return (month >= 1 && month <= 12) ? days[month - 1] : 31; //corrupt or unset month register: counted like the part does, 31 days then January
+}
+
+static void DS3231_SoftClockTick(volatile DS3231_SoftTime* now) //one second forward, through the calendar like the countdown chain
+{
+	if(++now->time[0] < 60)
+	{
+		return;
+	}
+	now->time[0] = 0;
+	if(++now->time[1] < 60)
 	{
-		uint8_t date = (control & 0xC0) | conv; //preserve Alarm Bit & DY/DT-Bit
-		dev->status = DS3231_WriteRegister(dev,DS3231_ALARM1_DAY_DATE_REG,&date);
 		return;
 	}
-	else
+	now->time[1] = 0;
+	if(++now->time[2] < 24)
+	{
+		return;
+	}
+	now->time[2] = 0;
+	now->date[0] = (now->date[0] % 7) + 1;
+	if(++now->date[1] <= DS3231_DaysInMonth(now->date[2],now->date[3]))
 	{
 		return;
 	}
+	now->date[1] = 1;
+	if(++now->date[2] <= 12)
+	{
+		return;
+	}
+	now->date[2] = 1;
+	now->date[3] = (now->date[3] + 1) % 100;
 }
 
-
-//Configuration Functions
-void DS3231_OscillatorEnable(DS3231* dev, DS3231_States state)
+static uint8_t DS3231_SoftClockLoad(DS3231_SoftClock* clock) //reads the RTC and installs it, unless an edge came in between; 1 if installed
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_REG, &control);
-	if(dev->status == HAL_OK)
+	DS3231* dev = clock->dev;
+	uint32_t edges = clock->edges;
+	DS3231_GetDateTime(dev);
+	if(dev->status != HAL_OK)
 	{
-		if(state == Enabled)
-		{
-			if(!DS_READ_BIT(control,DS3231_EOSC)) //EOSC is negated
-			{
-				return;
-			}
-			else
-			{
-				DS_SET_BIT(control,DS3231_EOSC);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+		return 0;
+	}
 
+	uint8_t installed = 0;
+	DS3231_LOCK(); //edge interrupt out while the check and the copy happen
+	if(clock->edges == edges)
+	{
+		uint8_t slipped = 0;
+		clock->seq++;
+		DS3231_BARRIER();
+		for(uint8_t i = 0; i < sizeof(dev->time); i++)
+		{
+			slipped |= clock->now.time[i] != dev->time[i];
+			clock->now.time[i] = dev->time[i];
 		}
-		else if(state == Disabled)
+		for(uint8_t i = 0; i < sizeof(dev->date); i++)
 		{
-			if(DS_READ_BIT(control,DS3231_EOSC))
-			{
-				return;
-			}
-			else
-			{
-				DS_CLEAR_BIT(control,DS3231_EOSC);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+			slipped |= clock->now.date[i] != dev->date[i];
+			clock->now.date[i] = dev->date[i];
 		}
-	}
-	else
+		DS3231_BARRIER();
+		clock->seq++;
+		clock->since_sync = 0;
+		clock->slips += slipped;
+		installed = 1;
+	}
+	DS3231_UNLOCK();
+	return installed;
+}
+
+void DS3231_SoftClockStart(DS3231_SoftClock* clock, DS3231* dev, DS3231_Timer timer, uint32_t timer_hz, uint32_t resync_s)
+{
+	clock->dev = dev;
+	clock->timer = timer;
+	clock->timer_hz = timer_hz;
+	clock->resync_s = resync_s;
+	clock->seq = 0;
+	clock->edge_ticks = timer();
+	clock->edge_seen = 0;
+	clock->edges = 0;
+	clock->since_sync = 0;
+
+	DS3231_Config config; //1 Hz square wave instead of alarm interrupts
+	DS3231_GetConfig(dev,&config);
+	config.rate = Rate_1_HZ;
+	config.interrupt = Disabled;
+	DS3231_ApplyConfig(dev,&config);
+	if(dev->status != HAL_OK)
 	{
 		return;
 	}
+
+	while(!DS3231_SoftClockLoad(clock) && dev->status == HAL_OK) //an edge between the read and the copy: read again
+	{
+	}
+	clock->slips = 0;
+	clock->resyncs = 0;
 }
 
-uint8_t DS3231_IsOscillatorSet(DS3231* dev)
+void DS3231_SoftClockEdge(DS3231_SoftClock* clock)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_REG, &control);
-	return (!DS_READ_BIT(control,DS3231_EOSC)); //returns 1 for Enabled Oscillator (on Power On) (EOSC is negated)
+	uint32_t ticks = clock->timer();
+	clock->seq++;
+	DS3231_BARRIER();
+	DS3231_SoftClockTick(&clock->now);
+	clock->edge_ticks = ticks;
+	clock->edge_seen = 1;
+	DS3231_BARRIER();
+	clock->seq++;
+	clock->edges++;
+	clock->since_sync++;
 }
 
-void DS3231_BBSQWEnable(DS3231* dev, DS3231_States state)
+void DS3231_SoftClockRead(DS3231_SoftClock* clock, DS3231_SoftTime* out)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_REG, &control);
-	if(dev->status == HAL_OK)
-	{
-		if(state == Enabled)
+	uint32_t seq;
+	uint32_t edge_ticks;
+	uint8_t edge_seen;
+	do
+	{
+		seq = clock->seq;
+		DS3231_BARRIER();
+		for(uint8_t i = 0; i < sizeof(out->time); i++)
 		{
-			if(DS_READ_BIT(control,DS3231_BBSQW))
-			{
-				return;
-			}
-			else
-			{
-				DS_SET_BIT(control,DS3231_BBSQW);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
-
+			out->time[i] = clock->now.time[i];
 		}
-		else if(state == Disabled)
+		for(uint8_t i = 0; i < sizeof(out->date); i++)
 		{
-			if(!DS_READ_BIT(control,DS3231_BBSQW))
-			{
-				return;
-			}
-			else
-			{
-				DS_CLEAR_BIT(control,DS3231_BBSQW);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+			out->date[i] = clock->now.date[i];
+		}
+		edge_ticks = clock->edge_ticks;
+		edge_seen = clock->edge_seen;
+		DS3231_BARRIER();
+	}while((seq & 1U) || seq != clock->seq); //the edge interrupt ran meanwhile: copy again
+
+	uint32_t ms = 0;
+	if(edge_seen)
+	{
+		ms = (uint32_t)((uint64_t)(clock->timer() - edge_ticks) * 1000U / clock->timer_hz);
+		if(ms > 999) //edge late or missed: hold at the end of the second until it comes or the next resync
+		{
+			ms = 999;
 		}
 	}
-	else
+	out->ms = (uint16_t)ms;
+}
+
+void DS3231_SoftClockService(DS3231_SoftClock* clock)
+{
+	if(clock->resync_s == 0 || clock->since_sync < clock->resync_s)
 	{
 		return;
 	}
+	if(DS3231_SoftClockLoad(clock))
+	{
+		clock->resyncs++;
+	}
 }
 
-uint8_t DS3231_IsBBSQWSet(DS3231* dev)
+
+//Timer Scheduler Functions
+static uint8_t DS3231_TimerBefore(const DS3231_TimerEntry* a, const DS3231_TimerEntry* b) //earlier deadline first, then the one started first
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG, &control);
-	return (DS_READ_BIT(control,DS3231_BBSQW)); //returns 1 for BBSQW = 1 (on Power On)
+	return a->deadline < b->deadline || (a->deadline == b->deadline && a->id < b->id);
 }
 
-void DS3231_RateSelect(DS3231* dev, DS3231_Rate rate)
+static void DS3231_HeapSiftUp(DS3231_Scheduler* sched, uint8_t i)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_REG, &control);
-	if(dev->status == HAL_OK)
+	DS3231_TimerEntry entry = sched->heap[i];
+	while(i > 0 && DS3231_TimerBefore(&entry,&sched->heap[(i - 1) / 2]))
 	{
-		if(rate == Rate_1_HZ)
-		{
-			if((!DS_READ_BIT(control,DS3231_RS_2) && !DS_READ_BIT(control,DS3231_RS_1)))
-			{
-				return;
-			}
-			else
-			{
-				DS_CLEAR_BIT(control,DS3231_RS_2);
-				DS_CLEAR_BIT(control,DS3231_RS_1);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+		sched->heap[i] = sched->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	sched->heap[i] = entry;
+}
 
-		}
-		else if(rate == Rate_1024_HZ)
+static void DS3231_HeapSiftDown(DS3231_Scheduler* sched, uint8_t i)
+{
+	DS3231_TimerEntry entry = sched->heap[i];
+	for(;;)
+	{
+		uint8_t child = 2 * i + 1;
+		if(child >= sched->count)
 		{
-			if((!DS_READ_BIT(control,DS3231_RS_2) && DS_READ_BIT(control,DS3231_RS_1)))
-			{
-				return;
-			}
-			else
-			{
-				DS_CLEAR_BIT(control,DS3231_RS_2);
-				DS_SET_BIT(control,DS3231_RS_1);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+			break;
 		}
-		else if(rate == Rate_4096_HZ)
+		if(child + 1 < sched->count && DS3231_TimerBefore(&sched->heap[child + 1],&sched->heap[child]))
 		{
-			if(DS_READ_BIT(control,DS3231_RS_2) && !DS_READ_BIT(control,DS3231_RS_1))
-			{
-				return;
-			}
-			else
-			{
-				DS_SET_BIT(control,DS3231_RS_2);
-				DS_CLEAR_BIT(control,DS3231_RS_1);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+			child++;
 		}
-		else if(rate == Rate_8192_HZ)
+		if(!DS3231_TimerBefore(&sched->heap[child],&entry))
 		{
-			if(DS_READ_BIT(control,DS3231_RS_2) && DS_READ_BIT(control,DS3231_RS_1))
-			{
-				return;
-			}
-			else
-			{
-				DS_SET_BIT(control,DS3231_RS_2);
-				DS_SET_BIT(control,DS3231_RS_1);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+			break;
 		}
+		sched->heap[i] = sched->heap[child];
+		i = child;
 	}
-	else
-	{
-		return;
-	}
+	sched->heap[i] = entry;
 }
 
-uint8_t DS3231_IsRateSelectSet(DS3231* dev)
+static void DS3231_HeapInsert(DS3231_Scheduler* sched, const DS3231_TimerEntry* entry)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_REG, &control);
-	return (DS_READ_BIT(control,DS3231_RS_2) && DS_READ_BIT(control,DS3231_RS_1)); //returns 1 for RS2 & RS1 = 1 (on Power On)
+	sched->heap[sched->count] = *entry;
+	sched->count++;
+	DS3231_HeapSiftUp(sched,sched->count - 1);
 }
 
-void DS3231_InterruptEnable(DS3231* dev, DS3231_States state)
+static void DS3231_HeapRemove(DS3231_Scheduler* sched, uint8_t i)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_REG, &control);
-	if(dev->status == HAL_OK)
+	sched->count--;
+	if(i < sched->count) //last entry into the gap, then whichever way it belongs
 	{
-		if(state == Enabled)//AlarmInterrupt-Mode
-		{
-			if(DS_READ_BIT(control,DS3231_INTCN))
-			{
-				return;
-			}
-			else
-			{
-				DS_SET_BIT(control,DS3231_INTCN);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+		sched->heap[i] = sched->heap[sched->count];
+		DS3231_HeapSiftUp(sched,i);
+		DS3231_HeapSiftDown(sched,i);
+	}
+}
 
-		}
-		else if(state == Disabled)//SQW-Mode
+static void DS3231_SchedulerDispatch(DS3231_Scheduler* sched, int64_t now)
+{
+	while(sched->count > 0 && sched->heap[0].deadline <= now)
+	{
+		DS3231_TimerEntry entry = sched->heap[0];
+		DS3231_HeapRemove(sched,0);
+		if(entry.period != 0) //back in before the callback, so it can cancel itself; missed periods are skipped, not run back to back
 		{
-			if(DS_READ_BIT(control,DS3231_INTCN))
-			{
-				return;
-			}
-			else
-			{
-				DS_CLEAR_BIT(control,DS3231_INTCN);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_REG, &control);
-				return;
-			}
+			DS3231_TimerEntry next = entry;
+			next.deadline += (int64_t)entry.period * ((now - entry.deadline) / entry.period + 1);
+			DS3231_HeapInsert(sched,&next);
 		}
+		sched->dispatched++;
+		entry.callback(sched,entry.id,entry.context);
 	}
-	else
+}
+
+static void DS3231_SchedulerArm(DS3231_Scheduler* sched) //nearest deadline into 0x07-0x0A
+{
+	if(sched->count == 0) //left as it is: a match with nothing due only costs a spurious service
 	{
 		return;
 	}
+	DS3231_DateTime dt;
+	DS3231_EpochToDateTime(sched->heap[0].deadline,&dt);
+	static const uint8_t masks[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+	uint8_t values[4]; //A1M1-A1M4 and DY/DT 0: date, hours, minutes and seconds match, not the month, so far deadlines also match in earlier months; hours in 24 hour mode
+	values[0] = DecToBCD(dt.sec);
+	values[1] = DecToBCD(dt.min);
+	values[2] = DecToBCD(dt.hour);
+	values[3] = DecToBCD(dt.mday);
+	sched->dev->status = DS3231_UpdateRegisters(sched->dev,DS3231_ALARM1_SECONDS_REG,masks,values,sizeof(values)); //one burst over the bytes that changed, none if already armed
 }
 
-uint8_t DS3231_IsInterruptSet(DS3231* dev)
+void DS3231_SchedulerInit(DS3231_Scheduler* sched, DS3231* dev)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_REG, &control);
-	return (DS_READ_BIT(control,DS3231_INTCN)); //returns 1 for INTCN = 1 (on Power On)
+	sched->dev = dev;
+	sched->count = 0;
+	sched->next_id = 1;
+	sched->pending = 0;
+	sched->rearm = 0;
+	sched->wakeups = 0;
+	sched->dispatched = 0;
+
+	DS3231_Config config;
+	DS3231_GetConfig(dev,&config);
+	config.interrupt = Enabled;
+	config.alarm1 = Enabled;
+	config.clear_flags = (1U << DS3231_A1F);
+	DS3231_ApplyConfig(dev,&config);
 }
 
-void DS3231_32kHzEnable(DS3231* dev, DS3231_States state)
+uint32_t DS3231_TimerStart(DS3231_Scheduler* sched, int64_t deadline, uint32_t period, DS3231_TimerCallback callback, void* context)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG, &control);
-	if(dev->status == HAL_OK)
+	if(sched->count >= DS3231_TIMERS || callback == NULL)
 	{
-		if(state == Enabled)
-		{
-			if(DS_READ_BIT(control,DS3231_EN32kHz))
-			{
-				return;
-			}
-			else
-			{
-				DS_SET_BIT(control,DS3231_EN32kHz);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_STATUS_REG, &control);
-				return;
-			}
+		return 0;
+	}
+	DS3231_TimerEntry entry;
+	entry.deadline = deadline;
+	entry.period = period;
+	entry.id = sched->next_id;
+	entry.callback = callback;
+	entry.context = context;
+	sched->next_id++;
+	if(sched->next_id == 0)
+	{
+		sched->next_id = 1;
+	}
+	DS3231_HeapInsert(sched,&entry);
+	if(sched->heap[0].id == entry.id) //new nearest deadline: Alarm 1 is written by the next service
+	{
+		sched->rearm = 1;
+	}
+	return entry.id;
+}
 
-		}
-		else if(state == Disabled)
+uint8_t DS3231_TimerCancel(DS3231_Scheduler* sched, uint32_t id)
+{
+	for(uint8_t i = 0; i < sched->count; i++)
+	{
+		if(sched->heap[i].id == id)
 		{
-			if(DS_READ_BIT(control,DS3231_EN32kHz))
-			{
-				return;
-			}
-			else
+			DS3231_HeapRemove(sched,i);
+			if(i == 0)
 			{
-				DS_CLEAR_BIT(control,DS3231_EN32kHz);
-				dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_STATUS_REG, &control);
-				return;
+				sched->rearm = 1;
 			}
+			return 1;
 		}
 	}
-	else
-	{
-		return;
-	}
+	return 0;
 }
 
-uint8_t DS3231_Is32kHzSet(DS3231* dev)
+int64_t DS3231_SchedulerNext(DS3231_Scheduler* sched)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG, &control);
-	return (DS_READ_BIT(control,DS3231_EN32kHz)); //returns 1 for EN32kHz = 1 (on Power On)
+	return sched->count > 0 ? sched->heap[0].deadline : 0;
 }
 
-void DS3231_ClearOscillatorStoppedFlag(DS3231* dev)
+void DS3231_SchedulerInterrupt(DS3231_Scheduler* sched)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG, &control);
-	DS_CLEAR_BIT(control,DS3231_OSF);
-	if(dev->status==HAL_OK)
+	sched->pending = 1;
+}
+
+void DS3231_SchedulerService(DS3231_Scheduler* sched)
+{
+	DS3231* dev = sched->dev;
+	if(!sched->pending && !sched->rearm)
 	{
-		dev->status = DS3231_WriteRegister(dev,DS3231_CONTROL_STATUS_REG, &control);
 		return;
 	}
+	sched->wakeups++;
+	if(sched->pending)
+	{
+		sched->pending = 0;
+		DS3231_ClearAlarm1Flag(dev); //before the time is read: a match from here on pulls INT/SQW low again
+		if(dev->status != HAL_OK)
+		{
+			sched->pending = 1;
+			return;
+		}
+	}
+
+	int64_t now = DS3231_GetEpoch(dev);
+	while(dev->status == HAL_OK)
+	{
+		DS3231_SchedulerDispatch(sched,now);
+		DS3231_SchedulerArm(sched);
+		if(dev->status != HAL_OK || sched->count == 0 || sched->heap[0].deadline > now + 1)
+		{
+			break;
+		}
+		now = DS3231_GetEpoch(dev); //due with the next seconds update: the write may have come after it and missed the match
+		if(dev->status == HAL_OK && now < sched->heap[0].deadline)
+		{
+			break;
+		}
+	}
+	sched->rearm = (dev->status != HAL_OK); //retried by the next service
 }
 
-uint8_t DS3231_IsOscillatorStoppedSet(DS3231* dev)
+
+//Low-Level Functions
+void DS3231_SetBusPolicy(DS3231* dev, uint32_t bus_hz, uint8_t retries, DS3231_BusRecover recover)
 {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev,DS3231_CONTROL_STATUS_REG, &control);
-	return (DS_READ_BIT(control,DS3231_OSF)); //returns 1 for EN32kHz = 1 (on Power On)
+	dev->bus_hz = bus_hz ? bus_hz : DS3231_BUS_HZ;
+	dev->retries = retries;
+	dev->recover = recover;
 }
 
+uint32_t DS3231_TimeoutMs(DS3231* dev, uint8_t read, uint8_t length)
+{
+	//START, address, register, (repeated START, address,) data bytes at 9 clocks each, STOP
+	uint32_t clocks = read ? (27U + 9U * length + 3U) : (18U + 9U * length + 2U);
+	uint32_t bus_ms = (clocks * 1000U + dev->bus_hz - 1) / dev->bus_hz;
+	return DS3231_TIMEOUT_MARGIN * bus_ms + 1; //+1: the tick may advance right after the start
+}
 
-//Temperature Functions
-void DS3231_Get_Temp(DS3231* dev)
+static HAL_StatusTypeDef DS3231_Transfer(DS3231* dev, uint8_t read, uint8_t reg, uint8_t* data, uint8_t length) //bounded timeout, retries with backoff, bus recovery
 {
-	uint8_t temp[2];
-	dev->status = DS3231_ReadRegisters(dev,DS3231_TEMPERATURE_MSB_REG,temp,sizeof(temp));
+	uint32_t timeout = DS3231_TimeoutMs(dev,read,length);
+	uint32_t start = DS3231_TIME_US();
+	HAL_StatusTypeDef status = HAL_ERROR;
 
-	if(dev->status == HAL_OK)
+	for(uint8_t attempt = 0; attempt <= dev->retries; attempt++)
 	{
-		int8_t msb = (int8_t)temp[0]; // signed integer part
-		uint8_t lsb = temp[1];
-
-		int16_t fraction = (lsb >> 6) * 25; // convert to hundredths of °C
-		if(msb >= 0)
+		if(attempt > 0)
 		{
-			dev->temp = msb * 100 + fraction;
-			return;
+			dev->stats.retries++;
+			HAL_Delay(DS3231_BACKOFF_MS << (attempt - 1));
+		}
+		if(read)
+		{
+			status = HAL_I2C_Mem_Read(dev->i2cHandle, DS3231_I2C_ADDRESS,reg, I2C_MEMADD_SIZE_8BIT,data,length,timeout);
 		}
 		else
 		{
-			dev->temp = msb * 100 - fraction;
-			return;
+			status = HAL_I2C_Mem_Write(dev->i2cHandle, DS3231_I2C_ADDRESS,reg, I2C_MEMADD_SIZE_8BIT,data,length,timeout);
+		}
+		if(status == HAL_OK)
+		{
+			break;
+		}
+		if(status == HAL_TIMEOUT || status == HAL_BUSY) //SDA held low by the part or the peripheral stuck
+		{
+			if(status == HAL_TIMEOUT)
+			{
+				dev->stats.timeouts++;
+			}
+			else
+			{
+				dev->stats.errors++;
+			}
+			if(dev->recover)
+			{
+				dev->recover(dev->i2cHandle);
+				dev->stats.recoveries++;
+			}
+		}
+		else
+		{
+			dev->stats.errors++;
 		}
-
 	}
-	else
+
+	uint32_t elapsed = DS3231_TIME_US() - start;
+	if(elapsed > dev->stats.worst_us)
 	{
-		dev->temp = 0;
-		return;
+		dev->stats.worst_us = elapsed;
 	}
-}
-
-void DS3231_Force_TempConversion(DS3231 *dev) {
-	uint8_t control;
-	dev->status = DS3231_ReadRegister(dev, DS3231_CONTROL_STATUS_REG, &control);
-	if (dev->status == HAL_OK) {
-		uint8_t bsy = DS_READ_BIT(control, DS3231_BSY);
-		if (bsy == 1) {
-			return;
-		} else {
-			dev->status = DS3231_ReadRegister(dev, DS3231_CONTROL_REG,
-					&control);
-			DS_SET_BIT(control, DS3231_CONV);
-			dev->status = DS3231_WriteRegister(dev, DS3231_CONTROL_REG,
-					&control);
-			return;
-		}
-	} else {
-		return;
+	dev->stats.transactions++;
+	if(status != HAL_OK)
+	{
+		dev->stats.failures++;
 	}
+	return status;
 }
 
-//Low-Level Functions
 HAL_StatusTypeDef DS3231_ReadRegister(DS3231* dev, uint8_t reg, uint8_t* data)
 {
-	return HAL_I2C_Mem_Read(dev->i2cHandle, DS3231_I2C_ADDRESS,reg, I2C_MEMADD_SIZE_8BIT,data,1,DS3231_DELAY);
+	return DS3231_Transfer(dev,1,reg,data,1);
 }
 
 HAL_StatusTypeDef DS3231_ReadRegisters(DS3231* dev, uint8_t reg, uint8_t* data, uint8_t length)
 {
-	return HAL_I2C_Mem_Read(dev->i2cHandle, DS3231_I2C_ADDRESS,reg, I2C_MEMADD_SIZE_8BIT,data,length,DS3231_DELAY);
+	return DS3231_Transfer(dev,1,reg,data,length);
 }
 
 HAL_StatusTypeDef DS3231_WriteRegister(DS3231* dev, uint8_t reg, uint8_t* data)
 {
-	return HAL_I2C_Mem_Write(dev->i2cHandle, DS3231_I2C_ADDRESS,reg, I2C_MEMADD_SIZE_8BIT,data,1,DS3231_DELAY);
+	return DS3231_Transfer(dev,0,reg,data,1);
 }
 
 HAL_StatusTypeDef DS3231_WriteRegisters(DS3231* dev, uint8_t reg, uint8_t* data, uint8_t length)
 {
-	return HAL_I2C_Mem_Write(dev->i2cHandle, DS3231_I2C_ADDRESS,reg, I2C_MEMADD_SIZE_8BIT,data,length,DS3231_DELAY);
+	return DS3231_Transfer(dev,0,reg,data,length);
 }
 
 
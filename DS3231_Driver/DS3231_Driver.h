@@ -14,7 +14,25 @@ extern "C" {
 
 #include "stm32l4xx_hal.h"
 
-#define DS3231_DELAY HAL_MAX_DELAY
+//Bus policy defaults (DS3231_SetBusPolicy() changes them per device)
+#define DS3231_BUS_HZ 100000 //SCL frequency the per-transaction timeouts are derived from
+#define DS3231_RETRIES 2 //extra attempts after a failed transaction
+#define DS3231_BACKOFF_MS 1 //wait before the first retry, doubled for each further one
+#define DS3231_TIMEOUT_MARGIN 2 //timeout = margin * bus time of the transfer + 1 tick
+#define DS3231_DELAY HAL_MAX_DELAY //deprecated: the driver no longer uses it (see DS3231_TimeoutMs()); kept for code that passed it to the HAL
+
+//Sections shared with interrupt handlers (async completions, SQW edges)
+#ifndef DS3231_LOCK
+#define DS3231_LOCK() uint32_t ds3231_primask = __get_PRIMASK(); __disable_irq() //PRIMASK saved, so calls from a critical section or ISR nest
+#define DS3231_UNLOCK() __set_PRIMASK(ds3231_primask) //restores it rather than unmasking; pairs with DS3231_LOCK() in the same scope
+#endif
+#ifndef DS3231_BARRIER
+#define DS3231_BARRIER() __DMB() //orders the soft clock's sequence counter against its data
+#endif
+
+#ifndef DS3231_TIME_US
+#define DS3231_TIME_US() (HAL_GetTick() * 1000U) //clock for worst-case figures; override with a us timer (DWT, TIMx) for finer ones
+#endif
 
 #define DS3231_I2C_ADDRESS (0x68 << 1)
 
@@ -46,6 +64,8 @@ extern "C" {
 #define DS3231_TEMPERATURE_MSB_REG 0x11
 #define DS3231_TEMPERATURE_LSB_REG 0x12
 
+#define DS3231_SHADOW_REGS (DS3231_CONTROL_STATUS_REG + 1) //shadow copy covers 0x00-0x0F
+
 //Special Bit defines
 #define DS3231_12_24 6
 #define DS3231_AM_PM_20_HOUR 5
@@ -79,6 +99,20 @@ extern "C" {
 #define DS3231_A1F 0
 
 
+//Bus Counters
+typedef struct DS3231_BusStats{
+	uint32_t transactions;
+	uint32_t retries;
+	uint32_t timeouts; //attempts that ran into their timeout
+	uint32_t errors; //attempts that failed otherwise (NACK, arbitration lost)
+	uint32_t recoveries; //times the bus recovery hook ran
+	uint32_t failures; //transactions still failed after all retries
+	uint32_t worst_us; //longest transaction, retries and backoff included
+}DS3231_BusStats;
+
+typedef void (*DS3231_BusRecover)(I2C_HandleTypeDef* hi2c); //board specific: 9 SCL clocks as GPIO + STOP, then re-init the peripheral
+
+
 //DS3231 Struct
 typedef struct DS3231{
 	//I2C-Handle
@@ -91,6 +125,14 @@ typedef struct DS3231{
 	int16_t temp;
 	//Error status
 	HAL_StatusTypeDef status;
+	//Shadow registers by address: hour mode, alarms, control, EN32kHz (bits the part never changes by itself)
+	uint8_t shadow[DS3231_SHADOW_REGS];
+	uint8_t shadow_valid;
+	//Bus policy and counters
+	uint32_t bus_hz;
+	uint8_t retries;
+	DS3231_BusRecover recover; //NULL: no recovery, retries only
+	DS3231_BusStats stats;
 }DS3231;
 
 
@@ -115,6 +157,19 @@ typedef enum DS3231_Alarmmode2{
 	ALARM_2_EVERY_M = 0x07, ALARM_2_MATCH_M = 0x06, ALARM_2_MATCH_M_H = 0x04, ALARM_2_MATCH_DATE_M_H= 0x00, ALARM_2_MATCH_DAY_M_H = 0x80
 }DS3231_Alarmmode2;
 
+typedef struct DS3231_Config{
+	//Control register
+	DS3231_States oscillator; //on battery (EOSC)
+	DS3231_States bbsqw;
+	DS3231_Rate rate;
+	DS3231_States interrupt; //INTCN: Enabled = alarm interrupts, Disabled = square wave
+	DS3231_States alarm1;
+	DS3231_States alarm2;
+	//Status register
+	DS3231_States out_32kHz;
+	uint8_t clear_flags; //any of (1 << DS3231_OSF), (1 << DS3231_A2F), (1 << DS3231_A1F)
+}DS3231_Config;
+
 
 //Init Function
 uint8_t DS3231_Init(DS3231* dev, I2C_HandleTypeDef* i2cHandle);
@@ -152,6 +207,35 @@ void DS3231_SetYear(DS3231* dev, uint8_t year);
 void DS3231_SetFullDate(DS3231* dev, uint8_t day, uint8_t date, uint8_t month, uint8_t year);
 
 
+//Date & Time Functions
+void DS3231_GetDateTime(DS3231* dev); //time[] and date[] from one 7 byte burst read
+void DS3231_SetDateTime(DS3231* dev, uint8_t sec, uint8_t min, uint8_t hour, uint8_t dow, uint8_t date, uint8_t month, uint8_t year); //one 7 byte burst write
+
+
+//Calendar Functions (raw 0x00-0x06 block <-> seconds since 1970-01-01 00:00:00, years 2000-2199 with the century bit)
+//The part counts every year divisible by 4 as a leap year: its 29.02.2100 converts as 01.03.2100.
+//Epochs are int64_t; they fit a uint32_t up to 2106-02-07.
+typedef struct DS3231_DateTime{
+	uint8_t sec; //0-59
+	uint8_t min; //0-59
+	uint8_t hour; //0-23 in either hour mode
+	uint8_t wday; //0-6 from Sunday, computed from the date (the day of week register is user defined)
+	uint8_t mday; //1-31
+	uint8_t mon; //1-12
+	uint16_t year; //2000-2199
+	uint16_t yday; //0-365
+}DS3231_DateTime;
+
+void DS3231_DecodeBlock(const uint8_t* regs, DS3231_DateTime* dt); //all BCD fields at once in a 64 bit word
+void DS3231_EncodeBlock(uint8_t* regs, const DS3231_DateTime* dt, uint8_t mode); //mode: a hours register value in the wanted 12/24 hour mode; day of week written as wday + 1
+int64_t DS3231_DateTimeToEpoch(DS3231_DateTime* dt); //fills in wday and yday
+void DS3231_EpochToDateTime(int64_t epoch, DS3231_DateTime* dt);
+int64_t DS3231_BlockToEpoch(const uint8_t* regs);
+void DS3231_EpochToBlock(int64_t epoch, uint8_t* regs, uint8_t mode);
+int64_t DS3231_GetEpoch(DS3231* dev); //one 7 byte burst read, also fills time[] and date[]; 0 on error
+void DS3231_SetEpoch(DS3231* dev, int64_t epoch); //one 7 byte burst write, century bit included
+
+
 //Alarm Functions
 //Alarm 1 Functions
 void DS3231_Alarm1Enable(DS3231* dev, DS3231_States state);
@@ -179,6 +263,8 @@ void DS3231_SetAlarm2Date(DS3231* dev, uint8_t date);
 
 
 //Configuration Functions
+void DS3231_GetConfig(DS3231* dev, DS3231_Config* config); //from the shadow, clear_flags = 0
+void DS3231_ApplyConfig(DS3231* dev, const DS3231_Config* config); //0x0E-0x0F in one write, none if nothing changes
 void DS3231_OscillatorEnable(DS3231* dev, DS3231_States state);
 uint8_t DS3231_IsOscillatorSet(DS3231* dev);
 void DS3231_BBSQWEnable(DS3231* dev, DS3231_States state);
@@ -197,7 +283,129 @@ void DS3231_Get_Temp(DS3231* dev);
 void DS3231_Force_TempConversion(DS3231 *dev);
 
 
+//Shadow Register Functions
+HAL_StatusTypeDef DS3231_LoadShadow(DS3231* dev); //one burst read of 0x02-0x0F
+HAL_StatusTypeDef DS3231_UpdateBits(DS3231* dev, uint8_t reg, uint8_t mask, uint8_t value); //0x07-0x0F; no bus traffic if nothing changes
+HAL_StatusTypeDef DS3231_UpdateRegisters(DS3231* dev, uint8_t reg, const uint8_t* mask, const uint8_t* value, uint8_t length); //one burst over the changed span
+
+
+//Asynchronous Functions (HAL _IT transfers, _DMA with DS3231_ASYNC_DMA defined)
+//Requests run in order; the application forwards HAL_I2C_MemRxCpltCallback/MemTxCpltCallback (HAL_OK)
+//and HAL_I2C_ErrorCallback (HAL_ERROR) to DS3231_AsyncTransferDone(). Don't mix with blocking calls while requests are pending.
+#ifndef DS3231_ASYNC_QUEUE
+#define DS3231_ASYNC_QUEUE 4
+#endif
+
+typedef void (*DS3231_Callback)(DS3231* dev, uint32_t token, HAL_StatusTypeDef status); //from the I2C interrupt
+
+typedef enum DS3231_RequestType{
+	Request_GetDateTime, Request_SetDateTime, Request_Get_Temp, Request_ApplyConfig
+}DS3231_RequestType;
+
+typedef struct DS3231_Request{
+	DS3231_RequestType type;
+	uint8_t step; //transfers finished so far
+	uint8_t data[7]; //registers read or to be written
+	uint8_t masks[2];
+	uint8_t scratch;
+	uint8_t first, last; //span written by Request_ApplyConfig
+	DS3231_Callback callback;
+	uint32_t token;
+}DS3231_Request;
+
+typedef struct DS3231_Async{
+	DS3231* dev;
+	DS3231_Request queue[DS3231_ASYNC_QUEUE];
+	volatile uint8_t head; //request on the bus
+	volatile uint8_t count;
+	volatile uint8_t busy;
+	uint32_t next_token;
+	volatile uint32_t done_token;
+	HAL_StatusTypeDef result[DS3231_ASYNC_QUEUE]; //by token, kept until DS3231_ASYNC_QUEUE more requests finish
+}DS3231_Async;
+
+void DS3231_AsyncInit(DS3231_Async* async, DS3231* dev);
+uint32_t DS3231_GetDateTimeAsync(DS3231_Async* async, DS3231_Callback callback); //returns a token, 0 if the queue is full
+uint32_t DS3231_SetDateTimeAsync(DS3231_Async* async, uint8_t sec, uint8_t min, uint8_t hour, uint8_t dow, uint8_t date, uint8_t month, uint8_t year, DS3231_Callback callback);
+uint32_t DS3231_Get_TempAsync(DS3231_Async* async, DS3231_Callback callback);
+uint32_t DS3231_ApplyConfigAsync(DS3231_Async* async, const DS3231_Config* config, DS3231_Callback callback);
+HAL_StatusTypeDef DS3231_AsyncPoll(DS3231_Async* async, uint32_t token); //HAL_BUSY until the request finished, then its status
+void DS3231_AsyncTransferDone(DS3231_Async* async, I2C_HandleTypeDef* hi2c, HAL_StatusTypeDef result);
+
+
+//Software Clock Functions (1 Hz square wave on INT/SQW, one RTC read at start and per resync)
+//DS3231_SoftClockEdge() goes in the falling edge interrupt of INT/SQW, DS3231_SoftClockService() in the main loop.
+typedef uint32_t (*DS3231_Timer)(void); //free-running MCU timer, wraps at 2^32
+
+typedef struct DS3231_SoftTime{
+	uint8_t time[3]; //same layout as DS3231.time[] and .date[]
+	uint8_t date[4];
+	uint16_t ms; //interpolated from the MCU timer since the last edge
+}DS3231_SoftTime;
+
+typedef struct DS3231_SoftClock{
+	DS3231* dev;
+	DS3231_Timer timer;
+	uint32_t timer_hz;
+	uint32_t resync_s; //seconds between RTC reads, 0: never
+	volatile uint32_t seq; //odd while the edge interrupt writes now
+	volatile DS3231_SoftTime now; //ms unused: the second started at edge_ticks
+	volatile uint32_t edge_ticks;
+	volatile uint8_t edge_seen; //no sub-second information before the first edge
+	volatile uint32_t edges;
+	volatile uint32_t since_sync;
+	uint32_t resyncs;
+	uint32_t slips; //resyncs that found the RAM copy off (missed or extra edges)
+}DS3231_SoftClock;
+
+void DS3231_SoftClockStart(DS3231_SoftClock* clock, DS3231* dev, DS3231_Timer timer, uint32_t timer_hz, uint32_t resync_s); //1 Hz SQW, INTCN cleared, RTC read once
+void DS3231_SoftClockEdge(DS3231_SoftClock* clock); //falling edge of SQW: the seconds register just counted
+void DS3231_SoftClockRead(DS3231_SoftClock* clock, DS3231_SoftTime* out); //lock-free, no bus traffic
+void DS3231_SoftClockService(DS3231_SoftClock* clock); //resyncs from the RTC when due
+
+
+//Timer Scheduler Functions (any number of deadlines, up to DS3231_TIMERS, on Alarm 1)
+//Alarm 1 always holds the nearest deadline (date, hours, minutes, seconds match), so the MCU can sleep until INT/SQW falls.
+//DS3231_SchedulerInterrupt() goes in the falling edge interrupt of INT/SQW, DS3231_SchedulerService() in the main loop.
+//Deadlines are epoch seconds (DS3231_GetEpoch()). Alarm 1 has no month match: a deadline more than about 28 days ahead also matches
+//its date and time in each earlier month, and every such match is a spurious wake-up (A1F cleared, nothing dispatched, alarm kept).
+#ifndef DS3231_TIMERS
+#define DS3231_TIMERS 16
+#endif
+
+typedef struct DS3231_Scheduler DS3231_Scheduler;
+typedef void (*DS3231_TimerCallback)(DS3231_Scheduler* sched, uint32_t id, void* context); //from DS3231_SchedulerService(); may start and cancel timers
+
+typedef struct DS3231_TimerEntry{
+	int64_t deadline;
+	uint32_t period; //seconds, 0: one shot
+	uint32_t id;
+	DS3231_TimerCallback callback;
+	void* context;
+}DS3231_TimerEntry;
+
+struct DS3231_Scheduler{
+	DS3231* dev;
+	DS3231_TimerEntry heap[DS3231_TIMERS]; //min-heap on deadline, then id
+	uint8_t count;
+	uint32_t next_id;
+	volatile uint8_t pending; //A1F interrupt seen, flag not cleared yet
+	uint8_t rearm; //nearest deadline changed since Alarm 1 was written
+	uint32_t wakeups; //services that did bus traffic
+	uint32_t dispatched;
+};
+
+void DS3231_SchedulerInit(DS3231_Scheduler* sched, DS3231* dev); //INTCN and A1IE on, A1F cleared, in one write
+uint32_t DS3231_TimerStart(DS3231_Scheduler* sched, int64_t deadline, uint32_t period, DS3231_TimerCallback callback, void* context); //returns an id, 0 if full; no bus traffic
+uint8_t DS3231_TimerCancel(DS3231_Scheduler* sched, uint32_t id); //1 if it was pending; no bus traffic
+int64_t DS3231_SchedulerNext(DS3231_Scheduler* sched); //nearest deadline, 0 if none
+void DS3231_SchedulerInterrupt(DS3231_Scheduler* sched);
+void DS3231_SchedulerService(DS3231_Scheduler* sched); //dispatches what is due and rearms Alarm 1; nothing on the bus unless an interrupt came or the nearest deadline changed
+
+
 //Low-Level Functions
+void DS3231_SetBusPolicy(DS3231* dev, uint32_t bus_hz, uint8_t retries, DS3231_BusRecover recover); //after DS3231_Init
+uint32_t DS3231_TimeoutMs(DS3231* dev, uint8_t read, uint8_t length);
 HAL_StatusTypeDef DS3231_ReadRegister(DS3231* dev,uint8_t reg, uint8_t* data);
 HAL_StatusTypeDef DS3231_ReadRegisters(DS3231* dev, uint8_t reg, uint8_t* data, uint8_t length);
 HAL_StatusTypeDef DS3231_WriteRegister(DS3231* dev, uint8_t reg, uint8_t* data);
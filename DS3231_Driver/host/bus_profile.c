@@ -0,0 +1,932 @@
+/*
+ * bus_profile.c
+ *
+ *  Host program: runs DS3231_Driver.c against the emulator and prints the bus traffic of each driver call,
+ *  followed by checks of the emulated part itself. Exits with 1 if any check fails, so CI can run it as is.
+ *
+ *  usage: ./bus_profile [section]   (no section runs all of them)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "DS3231_Driver.h"
+#include "ds3231_emu.h"
+
+
+static DS3231_Emu emu;
+static I2C_HandleTypeDef hi2c;
+static DS3231 rtc;
+static DS3231_Async rtc_async;
+static DS3231_SoftClock soft;
+static int failures;
+
+
+//Helper Functions
+static void Profile_Setup(uint32_t bus_hz) //fresh part at power-on state, driver initialised, counters cleared
+{
+	DS3231_Emu_Init(&emu, bus_hz);
+	HAL_Host_Attach(&hi2c, &emu);
+	DS3231_Init(&rtc, &hi2c);
+	DS3231_Emu_ResetCounters(&emu);
+}
+
+static void Profile_Print(const char* name)
+{
+	printf("%-36s %4u transactions %5u bytes %10.1f us\n", name, (unsigned)emu.count.transactions,
+			(unsigned)emu.count.bytes, emu.count.bus_ns / 1000.0);
+	DS3231_Emu_ResetCounters(&emu);
+}
+
+static void Check(const char* name, int ok)
+{
+	printf("%-60s %s\n", name, ok ? "ok" : "FAIL");
+	if(!ok)
+	{
+		failures++;
+	}
+}
+
+static void Emu_Set(const uint8_t* regs, uint8_t reg, uint8_t length) //straight into the register file, no bus traffic
+{
+	memcpy(&emu.regs[reg], regs, length);
+}
+
+#define PROFILE(name, call) do { DS3231_Emu_ResetCounters(&emu); call; Profile_Print(name); } while(0)
+
+
+//Sections
+static void Section_Traffic(void) //transactions, bytes and bus time of each driver call at 100 and 400 kHz
+{
+	static const uint32_t speeds[2] = {100000, 400000};
+	for(int s = 0; s < 2; s++)
+	{
+		printf("////////////////// bus traffic per call, %u kHz //////////////////\n", (unsigned)(speeds[s] / 1000));
+		DS3231_Emu_Init(&emu, speeds[s]);
+		HAL_Host_Attach(&hi2c, &emu);
+		PROFILE("DS3231_Init", DS3231_Init(&rtc, &hi2c));
+		PROFILE("DS3231_GetTime", DS3231_GetTime(&rtc));
+		PROFILE("DS3231_GetFullDate", DS3231_GetFullDate(&rtc));
+		PROFILE("DS3231_GetDateTime", DS3231_GetDateTime(&rtc));
+		PROFILE("DS3231_SetTime", DS3231_SetTime(&rtc, 30, 45, 12));
+		PROFILE("DS3231_SetFullDate", DS3231_SetFullDate(&rtc, 3, 15, 6, 25));
+		PROFILE("DS3231_SetHours", DS3231_SetHours(&rtc, 13));
+		PROFILE("DS3231_Get_Temp", DS3231_Get_Temp(&rtc));
+		PROFILE("DS3231_Force_TempConversion", DS3231_Force_TempConversion(&rtc));
+		PROFILE("DS3231_RateSelect", DS3231_RateSelect(&rtc, Rate_1_HZ));
+		PROFILE("DS3231_InterruptEnable", DS3231_InterruptEnable(&rtc, Enabled));
+		PROFILE("DS3231_BBSQWEnable", DS3231_BBSQWEnable(&rtc, Enabled));
+		PROFILE("DS3231_Alarm1Enable", DS3231_Alarm1Enable(&rtc, Enabled));
+		PROFILE("DS3231_SetAlarm1Mode", DS3231_SetAlarm1Mode(&rtc, ALARM_1_MATCH_S));
+		PROFILE("DS3231_IsAlarm1FlagSet", DS3231_IsAlarm1FlagSet(&rtc));
+		PROFILE("DS3231_ClearAlarm1Flag", DS3231_ClearAlarm1Flag(&rtc));
+	}
+}
+
+static void Section_Config(void) //DS3231_Init and DS3231_ApplyConfig: one read, one write
+{
+	printf("////////////////// configuration, 100 kHz //////////////////\n");
+	DS3231_Emu_Init(&emu, 100000);
+	HAL_Host_Attach(&hi2c, &emu);
+	emu.regs[DS3231_CONTROL_STATUS_REG] |= (1 << DS3231_A1F) | (1 << DS3231_A2F); //OSF is already set at power-on
+	emu.regs[DS3231_CONTROL_REG] |= (1 << DS3231_A1IE);
+	DS3231_Init(&rtc, &hi2c);
+	Check("DS3231_Init is one read and one write", emu.count.reads == 1 && emu.count.writes == 1);
+	Check("flags cleared, alarms off, INTCN set, rate kept", emu.regs[DS3231_CONTROL_STATUS_REG] == (1 << DS3231_EN32kHz) &&
+			emu.regs[DS3231_CONTROL_REG] == 0x1C);
+
+	DS3231_Config config;
+	DS3231_GetConfig(&rtc, &config);
+	config.rate = Rate_1_HZ;
+	config.interrupt = Disabled;
+	config.out_32kHz = Disabled;
+	config.bbsqw = Enabled;
+	PROFILE("DS3231_ApplyConfig (4 settings)", DS3231_ApplyConfig(&rtc, &config));
+	Check("1 Hz square wave, BBSQW, 32kHz off", emu.regs[DS3231_CONTROL_REG] == (1 << DS3231_BBSQW) && emu.regs[DS3231_CONTROL_STATUS_REG] == 0x00);
+	PROFILE("DS3231_ApplyConfig (same again)", DS3231_ApplyConfig(&rtc, &config));
+	PROFILE("same 4 settings, one setter each",
+			DS3231_RateSelect(&rtc, Rate_8192_HZ); DS3231_InterruptEnable(&rtc, Enabled); DS3231_32kHzEnable(&rtc, Enabled); DS3231_BBSQWEnable(&rtc, Disabled));
+
+	DS3231_Emu_Init(&emu, 100000);
+	DS3231_Init(&rtc, &hi2c);
+	DS3231_32kHzEnable(&rtc, Disabled);
+	DS3231_Init(&rtc, &hi2c); //warm restart on battery
+	Check("DS3231_Init keeps 32kHz off across a restart", !DS_READ_BIT(emu.regs[DS3231_CONTROL_STATUS_REG], DS3231_EN32kHz));
+}
+
+static void Section_Cache(void) //shadow registers: setters that change nothing and Is*Set() stay off the bus
+{
+	printf("////////////////// shadow registers, 100 kHz //////////////////\n");
+	Profile_Setup(100000);
+	PROFILE("DS3231_IsOscillatorSet", DS3231_IsOscillatorSet(&rtc));
+	PROFILE("DS3231_IsInterruptSet", DS3231_IsInterruptSet(&rtc));
+	PROFILE("DS3231_Is32kHzSet", DS3231_Is32kHzSet(&rtc));
+	PROFILE("DS3231_RateSelect", DS3231_RateSelect(&rtc, Rate_1024_HZ));
+	PROFILE("DS3231_RateSelect again", DS3231_RateSelect(&rtc, Rate_1024_HZ));
+	PROFILE("DS3231_Alarm2Enable", DS3231_Alarm2Enable(&rtc, Enabled));
+	PROFILE("DS3231_Alarm2Enable again", DS3231_Alarm2Enable(&rtc, Enabled));
+	PROFILE("DS3231_SetAlarm1Mode", DS3231_SetAlarm1Mode(&rtc, ALARM_1_MATCH_DAY_S_M_H));
+	PROFILE("DS3231_SetAlarm1Mode again", DS3231_SetAlarm1Mode(&rtc, ALARM_1_MATCH_DAY_S_M_H));
+	PROFILE("DS3231_SetAlarm1Hours", DS3231_SetAlarm1Hours(&rtc, 7));
+	PROFILE("DS3231_SetAlarm1Hours again", DS3231_SetAlarm1Hours(&rtc, 7));
+	PROFILE("DS3231_SetHourMode (no change)", DS3231_SetHourMode(&rtc, Hour_24));
+	PROFILE("DS3231_ClearAlarm1Flag", DS3231_ClearAlarm1Flag(&rtc));
+
+	Profile_Setup(100000);
+	DS3231_InterruptEnable(&rtc, Disabled);
+	Check("InterruptEnable(Disabled) clears INTCN", !DS_READ_BIT(emu.regs[DS3231_CONTROL_REG], DS3231_INTCN));
+	DS3231_32kHzEnable(&rtc, Disabled);
+	Check("32kHzEnable(Disabled) clears EN32kHz", !DS_READ_BIT(emu.regs[DS3231_CONTROL_STATUS_REG], DS3231_EN32kHz));
+	DS3231_OscillatorEnable(&rtc, Disabled);
+	Check("OscillatorEnable(Disabled) sets EOSC", DS_READ_BIT(emu.regs[DS3231_CONTROL_REG], DS3231_EOSC));
+	DS3231_OscillatorEnable(&rtc, Enabled);
+	Check("OscillatorEnable(Enabled) clears EOSC", !DS_READ_BIT(emu.regs[DS3231_CONTROL_REG], DS3231_EOSC));
+	DS3231_BBSQWEnable(&rtc, Enabled);
+	Check("IsBBSQWSet follows BBSQW in the control register", DS3231_IsBBSQWSet(&rtc) == 1);
+	DS3231_RateSelect(&rtc, Rate_4096_HZ);
+	Check("RateSelect(4096 Hz) sets RS2 only", (emu.regs[DS3231_CONTROL_REG] & 0x18) == 0x10);
+
+	DS3231_SetAlarm1Mode(&rtc, ALARM_1_MATCH_DAY_S_M_H);
+	Check("day match sets DY/DT (bit 6), not A1M4", (emu.regs[DS3231_ALARM1_DAY_DATE_REG] & 0xC0) == 0x40);
+	DS3231_SetAlarm1Mode(&rtc, ALARM_1_EVERY_S);
+	Check("every second sets A1M1-A1M4, clears DY/DT", (emu.regs[DS3231_ALARM1_SECONDS_REG] & 0x80) && (emu.regs[DS3231_ALARM1_MINUTES_REG] & 0x80) &&
+			(emu.regs[DS3231_ALARM1_HOURS_REG] & 0x80) && (emu.regs[DS3231_ALARM1_DAY_DATE_REG] & 0xC0) == 0x80);
+	DS3231_SetAlarm1Seconds(&rtc, 42);
+	Check("SetAlarm1Seconds writes 0x07, keeps A1M1", emu.regs[DS3231_ALARM1_SECONDS_REG] == (0x80 | 0x42) &&
+			(emu.regs[DS3231_ALARM1_MINUTES_REG] & 0x7F) == 0x00);
+	DS3231_SetAlarm2Date(&rtc, 17);
+	Check("SetAlarm2Date writes 0x0D", (emu.regs[DS3231_ALARM2_DAY_DATE_REG] & 0x3F) == 0x17 && (emu.regs[DS3231_ALARM1_DAY_DATE_REG] & 0x3F) == 0x00);
+	DS3231_SetAlarm2HourMode(&rtc, Hour_12_AM_PM);
+	DS3231_SetAlarm2Hours(&rtc, 0);
+	Check("alarm 2 hour 0 in 12 hour mode is 12 AM", (emu.regs[DS3231_ALARM2_HOURS_REG] & 0x7F) == (0x40 | 0x12));
+
+	emu.regs[DS3231_CONTROL_STATUS_REG] |= (1 << DS3231_A1F) | (1 << DS3231_A2F);
+	DS3231_ClearAlarm1Flag(&rtc);
+	Check("ClearAlarm1Flag leaves A2F set", emu.regs[DS3231_CONTROL_STATUS_REG] == (1 << DS3231_A2F));
+
+	emu.regs[DS3231_CONTROL_STATUS_REG] |= (1 << DS3231_OSF); //power loss
+	emu.regs[DS3231_CONTROL_REG] = 0x1C; //power-on value
+	DS3231_IsOscillatorStoppedSet(&rtc);
+	DS3231_Emu_ResetCounters(&emu);
+	Check("OSF drops the shadow, next check reloads it", DS3231_IsInterruptSet(&rtc) == 1 && emu.count.transactions == 1);
+}
+
+//HAL callbacks, from the interrupt thread of hal_host.c
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+	DS3231_AsyncTransferDone(&rtc_async, hi2c, HAL_OK);
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+	DS3231_AsyncTransferDone(&rtc_async, hi2c, HAL_OK);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+	DS3231_AsyncTransferDone(&rtc_async, hi2c, HAL_ERROR);
+}
+
+static uint32_t async_calls;
+static uint32_t async_last_token;
+static int async_in_order;
+
+static void Async_Done(DS3231* dev, uint32_t token, HAL_StatusTypeDef status)
+{
+	(void)dev;
+	if(token != async_last_token + 1 || status != HAL_OK)
+	{
+		async_in_order = 0;
+	}
+	async_last_token = token;
+	async_calls++;
+}
+
+static void Section_Async(void) //queued _IT requests completed from the interrupt thread while the CPU keeps polling
+{
+	printf("////////////////// asynchronous requests, 100 kHz //////////////////\n");
+	Profile_Setup(100000);
+	DS3231_AsyncInit(&rtc_async, &rtc);
+	emu.temp_quarters = -41; //-10.25 degC from the next conversion
+	DS3231_Force_TempConversion(&rtc);
+	DS3231_Emu_Advance(&emu, DS3231_EMU_CONV_NS);
+	DS3231_Get_Temp(&rtc);
+	Check("DS3231_Get_Temp reads -10.25 degC as -1025", rtc.temp == -1025);
+
+	DS3231_Config config;
+	DS3231_GetConfig(&rtc, &config);
+	config.rate = Rate_1_HZ;
+	config.interrupt = Disabled;
+	async_calls = 0;
+	async_last_token = rtc_async.next_token;
+	async_in_order = 1;
+	DS3231_Emu_ResetCounters(&emu);
+
+	uint32_t tokens[4];
+	tokens[0] = DS3231_SetDateTimeAsync(&rtc_async, 30, 15, 18, 5, 24, 10, 25, Async_Done);
+	tokens[1] = DS3231_GetDateTimeAsync(&rtc_async, Async_Done);
+	tokens[2] = DS3231_Get_TempAsync(&rtc_async, Async_Done);
+	tokens[3] = DS3231_ApplyConfigAsync(&rtc_async, &config, Async_Done);
+	Check("fifth request is refused with token 0", DS3231_GetDateTimeAsync(&rtc_async, NULL) == 0);
+	uint64_t polls = 0;
+	while(DS3231_AsyncPoll(&rtc_async, tokens[3]) == HAL_BUSY)
+	{
+		polls++;
+	}
+	printf("4 requests: %u transactions, %.1f us on the bus, %llu polls by the CPU meanwhile\n", (unsigned)emu.count.transactions,
+			emu.count.bus_ns / 1000.0, (unsigned long long)polls);
+
+	int all_ok = 1;
+	for(int i = 0; i < 4; i++)
+	{
+		all_ok = all_ok && DS3231_AsyncPoll(&rtc_async, tokens[i]) == HAL_OK;
+	}
+	Check("all four tokens report HAL_OK", all_ok);
+	Check("callbacks ran once each, in submission order", async_calls == 4 && async_in_order);
+	Check("GetDateTime after SetDateTime sees 18:15:30 Fri 24.10.25", rtc.time[0] == 30 && rtc.time[1] == 15 && rtc.time[2] == 18 &&
+			rtc.date[0] == 5 && rtc.date[1] == 24 && rtc.date[2] == 10 && rtc.date[3] == 25);
+	Check("Get_Temp in the queue reads -1025", rtc.temp == -1025);
+	Check("ApplyConfig wrote 1 Hz square wave", emu.regs[DS3231_CONTROL_REG] == 0x00);
+	DS3231_Emu_ResetCounters(&emu);
+	Check("shadow follows the asynchronous write", DS3231_IsInterruptSet(&rtc) == 0 && emu.count.transactions == 0);
+	uint32_t same = DS3231_ApplyConfigAsync(&rtc_async, &config, NULL);
+	Check("unchanged config finishes at once, no bus traffic", DS3231_AsyncPoll(&rtc_async, same) == HAL_OK && emu.count.transactions == 0);
+
+	__disable_irq(); //the application's own critical section around a driver call
+	DS3231_AsyncPoll(&rtc_async, same);
+	Check("AsyncPoll inside a critical section leaves interrupts masked", __get_PRIMASK() == 1);
+	__enable_irq();
+	Check("and outside one leaves them enabled", DS3231_AsyncPoll(&rtc_async, same) == HAL_OK && __get_PRIMASK() == 0);
+}
+
+static void Faults_Print(const char* name, uint32_t start_us)
+{
+	printf("%-36s %-11s %2u tries %2u retries %2u timeouts %2u recoveries %8.1f ms\n", name, rtc.status == HAL_OK ? "HAL_OK" :
+			rtc.status == HAL_TIMEOUT ? "HAL_TIMEOUT" : "HAL_ERROR", (unsigned)(rtc.stats.retries + 1), (unsigned)rtc.stats.retries,
+			(unsigned)rtc.stats.timeouts, (unsigned)rtc.stats.recoveries, (HAL_Host_Micros() - start_us) / 1000.0);
+}
+
+static void Faults_Setup(uint32_t bus_hz, DS3231_BusRecover recover) //fresh part, 2 retries, counters cleared
+{
+	Profile_Setup(bus_hz);
+	DS3231_SetBusPolicy(&rtc, bus_hz, 2, recover);
+	rtc.stats = (DS3231_BusStats){0};
+}
+
+static void Section_Faults(void) //bounded timeouts, retries and bus recovery against injected faults
+{
+	printf("////////////////// faults, 100 kHz, 2 retries //////////////////\n");
+	Faults_Setup(100000, HAL_Host_BusRecover);
+	printf("timeouts: 1 byte read %u ms, 7 byte read %u ms, 7 byte write %u ms at 100 kHz; %u ms for a 7 byte read at 400 kHz\n",
+			(unsigned)DS3231_TimeoutMs(&rtc, 1, 1), (unsigned)DS3231_TimeoutMs(&rtc, 1, 7), (unsigned)DS3231_TimeoutMs(&rtc, 0, 7),
+			(unsigned)(DS3231_SetBusPolicy(&rtc, 400000, 2, HAL_Host_BusRecover), DS3231_TimeoutMs(&rtc, 1, 7)));
+
+	Faults_Setup(100000, HAL_Host_BusRecover);
+	uint32_t start = HAL_Host_Micros();
+	HAL_Host_InjectFaults(1, 0);
+	DS3231_GetDateTime(&rtc);
+	Faults_Print("one NACK", start);
+	Check("one NACK: retried once, then ok", rtc.status == HAL_OK && rtc.stats.retries == 1 && rtc.stats.errors == 1 && rtc.stats.failures == 0);
+
+	Faults_Setup(100000, HAL_Host_BusRecover);
+	start = HAL_Host_Micros();
+	HAL_Host_InjectFaults(3, 0);
+	DS3231_GetDateTime(&rtc);
+	Faults_Print("three NACKs", start);
+	Check("three NACKs: gives up after 2 retries", rtc.status == HAL_ERROR && rtc.stats.retries == 2 && rtc.stats.failures == 1);
+	HAL_Host_InjectFaults(0, 0);
+
+	Faults_Setup(100000, HAL_Host_BusRecover);
+	start = HAL_Host_Micros();
+	HAL_Host_InjectFaults(0, 1);
+	DS3231_GetDateTime(&rtc);
+	Faults_Print("SDA stuck, recovery hook", start);
+	Check("stuck SDA: one timeout, recovered, retry ok", rtc.status == HAL_OK && rtc.stats.timeouts == 1 && rtc.stats.recoveries == 1);
+	Check("worst case bounded by timeout + backoff + retry", rtc.stats.worst_us <= (DS3231_TimeoutMs(&rtc, 1, 7) + DS3231_BACKOFF_MS + 2) * 1000U);
+
+	Faults_Setup(100000, NULL);
+	start = HAL_Host_Micros();
+	HAL_Host_InjectFaults(0, 1);
+	DS3231_GetDateTime(&rtc);
+	Faults_Print("SDA stuck, no recovery hook", start);
+	Check("no recovery: HAL_TIMEOUT after 3 bounded tries", rtc.status == HAL_TIMEOUT && rtc.stats.timeouts == 3);
+	Check("and returns within 20 ms (HAL_MAX_DELAY: 49.7 days)", HAL_Host_Micros() - start < 20000U);
+	HAL_Host_InjectFaults(0, 0);
+
+	Faults_Setup(100000, HAL_Host_BusRecover);
+	HAL_Host_InjectFaults(1, 0);
+	DS3231_RateSelect(&rtc, Rate_1_HZ);
+	Check("NACKed write is retried, shadow stays valid", rtc.status == HAL_OK && rtc.shadow_valid && (emu.regs[DS3231_CONTROL_REG] & 0x18) == 0x00);
+	printf("counters: %u transactions, %u retries, %u errors, %u failures, worst %.1f ms\n", (unsigned)rtc.stats.transactions,
+			(unsigned)rtc.stats.retries, (unsigned)rtc.stats.errors, (unsigned)rtc.stats.failures, rtc.stats.worst_us / 1000.0);
+}
+
+static void Soft_Edge(void* context) //EXTI handler on INT/SQW
+{
+	DS3231_SoftClockEdge(context);
+}
+
+static uint32_t Soft_Timer(void) //free-running 1 MHz MCU timer
+{
+	return HAL_Host_Micros();
+}
+
+static int Soft_Matches(const DS3231_SoftTime* t) //RAM copy against the part's registers, no bus traffic
+{
+	const uint8_t* r = emu.regs;
+	return t->time[0] == BCDToDec(r[DS3231_SECONDS_REG]) && t->time[1] == BCDToDec(r[DS3231_MINUTES_REG]) &&
+			t->time[2] == BCDToDec(r[DS3231_HOURS_REG] & 0x3F) && t->date[0] == r[DS3231_DAY_OF_WEEK_REG] &&
+			t->date[1] == BCDToDec(r[DS3231_DATE_REG]) && t->date[2] == BCDToDec(r[DS3231_MONTH_REG] & 0x1F) &&
+			t->date[3] == BCDToDec(r[DS3231_YEAR_REG]);
+}
+
+static volatile int soft_stop;
+static volatile uint64_t soft_reads;
+static uint64_t soft_bad;
+
+static void* Soft_Reader(void* arg) //reads as fast as it can while the main thread runs time and edges forward
+{
+	(void)arg;
+	uint64_t prev = 0;
+	while(!soft_stop)
+	{
+		DS3231_SoftTime t;
+		DS3231_SoftClockRead(&soft, &t);
+		uint64_t key = (((((uint64_t)t.date[3] * 13 + t.date[2]) * 32 + t.date[1]) * 24 + t.time[2]) * 60 + t.time[1]) * 60 + t.time[0];
+		key = key * 1000 + t.ms;
+		if(t.time[0] > 59 || t.time[1] > 59 || t.time[2] > 23 || t.ms > 999 || key < prev) //torn or going backwards
+		{
+			soft_bad++;
+		}
+		prev = key;
+		soft_reads++;
+	}
+	return NULL;
+}
+
+static void Soft_Run(uint64_t seconds) //simulated time in 10 ms steps, main loop service after each
+{
+	for(uint64_t i = 0; i < seconds * 100; i++)
+	{
+		DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S / 100);
+		DS3231_SoftClockService(&soft);
+	}
+}
+
+static void Section_SoftClock(void) //time from the 1 Hz SQW edges instead of the bus
+{
+	printf("////////////////// software clock on 1 Hz SQW, 100 kHz //////////////////\n");
+	Profile_Setup(100000);
+	DS3231_SetDateTime(&rtc, 50, 59, 23, 2, 31, 12, 24);
+	emu.sqw_edge = Soft_Edge;
+	emu.sqw_context = &soft;
+	DS3231_Emu_ResetCounters(&emu);
+	DS3231_SoftClockStart(&soft, &rtc, Soft_Timer, 1000000, 0);
+	Profile_Print("DS3231_SoftClockStart");
+	Check("square wave at 1 Hz, INTCN cleared", (emu.regs[DS3231_CONTROL_REG] & 0x1C) == 0x00);
+
+	DS3231_SoftTime t;
+	DS3231_Emu_Advance(&emu, emu.next_tick_ns - emu.now_ns + 250 * 1000000ULL);
+	DS3231_SoftClockRead(&soft, &t);
+	Check("250 ms after an edge: same second, ms = 250", Soft_Matches(&t) && t.ms == 250);
+	Soft_Run(20);
+	DS3231_SoftClockRead(&soft, &t);
+	Check("edges alone carry it into 01.01.25", Soft_Matches(&t) && t.date[1] == 1 && t.date[2] == 1 && t.date[3] == 25);
+	DS3231_SetDateTime(&rtc, 55, 59, 23, 3, 28, 2, 24);
+	DS3231_SoftClockStart(&soft, &rtc, Soft_Timer, 1000000, 0);
+	Soft_Run(10);
+	DS3231_SoftClockRead(&soft, &t);
+	Check("and 28.02.24 into 29.02.24", Soft_Matches(&t) && t.date[1] == 29 && t.date[2] == 2);
+	static const uint8_t no_month[7] = {0x58, 0x59, 0x23, 0x04, 0x31, 0x00, 0x24}; //month register 0, as a corrupt or unset part may hold
+	Emu_Set(no_month, DS3231_SECONDS_REG, sizeof(no_month));
+	DS3231_SoftClockStart(&soft, &rtc, Soft_Timer, 1000000, 0);
+	Soft_Run(3);
+	DS3231_SoftClockRead(&soft, &t);
+	Check("month 0 rolls over into January like the part", Soft_Matches(&t) && t.date[1] == 1 && t.date[2] == 1);
+
+	DS3231_SoftClockStart(&soft, &rtc, Soft_Timer, 1000000, 60);
+	DS3231_Emu_ResetCounters(&emu);
+	soft_stop = 0;
+	soft_reads = 0;
+	soft_bad = 0;
+	pthread_t reader;
+	pthread_create(&reader, NULL, Soft_Reader, NULL);
+	while(soft_reads == 0) //reader running before time moves, or the hour can pass before it is scheduled
+	{
+		sched_yield();
+	}
+	Soft_Run(3600);
+	soft_stop = 1;
+	pthread_join(reader, NULL);
+	printf("1 hour, resync every 60 s: %llu lock-free reads, %u bus transactions (DS3231_GetTime: 3 per read)\n",
+			(unsigned long long)soft_reads, (unsigned)emu.count.transactions);
+	Check("no torn or backwards reads while edges came in", soft_bad == 0 && soft_reads > 0);
+	Check("one RTC read per resync, no slips", soft.resyncs == 60 && emu.count.transactions == 60 && soft.slips == 0);
+
+	emu.sqw_edge = NULL; //one edge lost
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	emu.sqw_edge = Soft_Edge;
+	DS3231_SoftClockRead(&soft, &t);
+	Check("a missed edge leaves it a second behind", !Soft_Matches(&t));
+	Soft_Run(60);
+	DS3231_SoftClockRead(&soft, &t);
+	Check("the next resync puts it right and counts a slip", Soft_Matches(&t) && soft.slips == 1);
+	emu.sqw_edge = NULL;
+}
+
+static void Calendar_Reference(int64_t epoch, uint8_t* regs, uint8_t h12) //block the part would hold, from libc's gmtime_r
+{
+	time_t t = (time_t)epoch;
+	struct tm tm;
+	gmtime_r(&t, &tm);
+	regs[DS3231_SECONDS_REG] = DecToBCD(tm.tm_sec);
+	regs[DS3231_MINUTES_REG] = DecToBCD(tm.tm_min);
+	regs[DS3231_HOURS_REG] = DecToBCD(tm.tm_hour);
+	if(h12)
+	{
+		regs[DS3231_HOURS_REG] = 0x40 | (tm.tm_hour >= 12 ? 0x20 : 0x00) | DecToBCD(tm.tm_hour % 12 == 0 ? 12 : tm.tm_hour % 12);
+	}
+	regs[DS3231_DAY_OF_WEEK_REG] = tm.tm_wday + 1;
+	regs[DS3231_DATE_REG] = DecToBCD(tm.tm_mday);
+	regs[DS3231_MONTH_REG] = DecToBCD(tm.tm_mon + 1) | (tm.tm_year >= 200 ? 0x80 : 0x00);
+	regs[DS3231_YEAR_REG] = DecToBCD(tm.tm_year % 100);
+}
+
+static int64_t Calendar_NaiveToEpoch(const uint8_t* regs) //field by field and day counting, as drivers usually do it
+{
+	static const uint8_t days_in_month[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	uint32_t year = 2000 + 100 * (regs[DS3231_MONTH_REG] >> 7) + BCDToDec(regs[DS3231_YEAR_REG]);
+	uint32_t mon = BCDToDec(regs[DS3231_MONTH_REG] & 0x1F);
+	int64_t days = 0;
+	for(uint32_t y = 1970; y < year; y++)
+	{
+		days += (y % 4 == 0 && (y % 100 != 0 || y % 400 == 0)) ? 366 : 365;
+	}
+	for(uint32_t m = 1; m < mon; m++)
+	{
+		days += days_in_month[m - 1] + (m == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0));
+	}
+	days += BCDToDec(regs[DS3231_DATE_REG] & 0x3F) - 1;
+	return days * 86400 + BCDToDec(regs[DS3231_HOURS_REG] & 0x3F) * 3600 + BCDToDec(regs[DS3231_MINUTES_REG]) * 60 + BCDToDec(regs[DS3231_SECONDS_REG]);
+}
+
+static double Calendar_Ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define CALENDAR_FIRST 946684800LL //2000-01-01 00:00:00
+#define CALENDAR_END 7258118400LL //2200-01-01 00:00:00
+#define CALENDAR_BENCH 1000000
+
+static void Section_Calendar(void) //register block <-> epoch, against libc over the part's whole range
+{
+	printf("////////////////// calendar: register block <-> Unix epoch //////////////////\n");
+	uint32_t conversions = 0;
+	uint32_t wrong = 0;
+	for(int64_t day = CALENDAR_FIRST; day < CALENDAR_END; day += 86400) //every day of 2000-2199, every hour, minutes and seconds varied
+	{
+		for(int64_t hour = 0; hour < 24; hour++)
+		{
+			int64_t epoch = day + hour * 3600 + (day / 86400 + hour * 7) % 60 * 60 + (day / 86400 * 13 + hour) % 60;
+			for(uint8_t h12 = 0; h12 < 2; h12++)
+			{
+				uint8_t expect[7];
+				uint8_t regs[7];
+				Calendar_Reference(epoch, expect, h12);
+				DS3231_EpochToBlock(epoch, regs, h12 ? 0x40 : 0x00);
+				time_t t = (time_t)epoch;
+				struct tm tm;
+				gmtime_r(&t, &tm);
+				DS3231_DateTime dt;
+				DS3231_DecodeBlock(expect, &dt);
+				if(memcmp(regs, expect, sizeof(regs)) != 0 || DS3231_BlockToEpoch(expect) != epoch || dt.wday != tm.tm_wday || dt.yday != tm.tm_yday)
+				{
+					wrong++;
+				}
+				conversions += 2;
+			}
+		}
+	}
+	printf("%u conversions over 2000-2199, 12 and 24 hour mode: %u differ from gmtime_r\n", (unsigned)conversions, (unsigned)wrong);
+	Check("every day and hour of 2000-2199 matches libc both ways", wrong == 0);
+
+	static const uint8_t leap_2100[7] = {0x00, 0x00, 0x00, 0x01, 0x29, 0x82, 0x00}; //29.02.2100, which the part counts
+	static const uint8_t first_2100[7] = {0x00, 0x00, 0x00, 0x01, 0x01, 0x83, 0x00};
+	Check("the part's 29.02.2100 converts as 01.03.2100", DS3231_BlockToEpoch(leap_2100) == DS3231_BlockToEpoch(first_2100));
+
+	Profile_Setup(100000);
+	PROFILE("DS3231_SetEpoch", DS3231_SetEpoch(&rtc, 4102444799LL)); //2099-12-31 23:59:59
+	Check("century bit clear in 2099", (emu.regs[DS3231_MONTH_REG] & 0x80) == 0 && emu.regs[DS3231_YEAR_REG] == 0x99);
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	int64_t epoch = 0;
+	PROFILE("DS3231_GetEpoch", epoch = DS3231_GetEpoch(&rtc));
+	Check("the part's rollover into 2100 reads back as the next second", epoch == 4102444800LL && rtc.date[3] == 0 && rtc.date[2] == 1);
+	DS3231_SetEpoch(&rtc, 4107542400LL); //2100-03-01
+	Check("SetEpoch sets the century bit itself", emu.regs[DS3231_MONTH_REG] == 0x83 && emu.regs[DS3231_YEAR_REG] == 0x00);
+
+	uint8_t blocks[64][7];
+	for(int i = 0; i < 64; i++)
+	{
+		Calendar_Reference(CALENDAR_FIRST + (CALENDAR_END - CALENDAR_FIRST) / 64 * i + i * 3671, blocks[i], 0);
+	}
+	volatile int64_t sink = 0;
+	double start = Calendar_Ns();
+	for(int i = 0; i < CALENDAR_BENCH; i++)
+	{
+		sink += DS3231_BlockToEpoch(blocks[i & 63]);
+	}
+	double fast = (Calendar_Ns() - start) / CALENDAR_BENCH;
+	start = Calendar_Ns();
+	for(int i = 0; i < CALENDAR_BENCH; i++)
+	{
+		sink += Calendar_NaiveToEpoch(blocks[i & 63]);
+	}
+	double naive = (Calendar_Ns() - start) / CALENDAR_BENCH;
+	printf("block -> epoch: %6.1f ns SWAR + days from civil, %6.1f ns per field + day counting\n", fast, naive);
+
+	uint8_t regs[7];
+	start = Calendar_Ns();
+	for(int i = 0; i < CALENDAR_BENCH; i++)
+	{
+		DS3231_EpochToBlock(CALENDAR_FIRST + (int64_t)i * 6311, regs, 0);
+		sink += regs[0];
+	}
+	fast = (Calendar_Ns() - start) / CALENDAR_BENCH;
+	start = Calendar_Ns();
+	for(int i = 0; i < CALENDAR_BENCH; i++)
+	{
+		Calendar_Reference(CALENDAR_FIRST + (int64_t)i * 6311, regs, 0);
+		sink += regs[0];
+	}
+	naive = (Calendar_Ns() - start) / CALENDAR_BENCH;
+	printf("epoch -> block: %6.1f ns civil from days,         %6.1f ns gmtime_r + DecToBCD\n", fast, naive);
+	(void)sink;
+}
+
+typedef struct Sched_Record{
+	int64_t next; //expected epoch of the next dispatch
+	int64_t slack; //seconds it may be late
+	uint32_t period;
+	uint32_t limit; //cancels itself after this many, 0: never
+	uint32_t count;
+	uint32_t wrong;
+}Sched_Record;
+
+static void Sched_Fire(DS3231_Scheduler* sched, uint32_t id, void* context)
+{
+	Sched_Record* r = context;
+	int64_t at = DS3231_BlockToEpoch(emu.regs); //the part's time at dispatch, no bus traffic
+	if(at < r->next || at > r->next + r->slack)
+	{
+		r->wrong++;
+	}
+	r->next += r->period;
+	r->count++;
+	if(r->limit && r->count == r->limit)
+	{
+		DS3231_TimerCancel(sched, id);
+	}
+}
+
+static uint32_t Sched_Start(DS3231_Scheduler* sched, Sched_Record* r, int64_t deadline, uint32_t period, uint32_t limit)
+{
+	memset(r, 0, sizeof(*r));
+	r->next = deadline;
+	r->period = period;
+	r->limit = limit;
+	return DS3231_TimerStart(sched, deadline, period, Sched_Fire, r);
+}
+
+static uint8_t sched_pin;
+
+static void Sched_Sleep(DS3231_Scheduler* sched) //MCU asleep until the next seconds update (+10 ms), then the main loop runs once
+{
+	DS3231_Emu_Advance(&emu, emu.next_tick_ns + 10 * 1000000ULL - emu.now_ns);
+	uint8_t pin = DS3231_Emu_IntSqwPin(&emu);
+	if(sched_pin && !pin) //EXTI on the falling edge of INT/SQW
+	{
+		DS3231_SchedulerInterrupt(sched);
+	}
+	sched_pin = pin;
+	DS3231_SchedulerService(sched);
+}
+
+#define SCHED_BASE 1738238400LL //2025-01-30 12:00:00
+#define SCHED_DAYS 41
+#define SCHED_RANDOM 10
+
+static void Section_Scheduler(void) //software timers multiplexed onto Alarm 1, 41 days of simulated time
+{
+	printf("////////////////// timer scheduler on Alarm 1, 100 kHz //////////////////\n");
+	static DS3231_Scheduler sched;
+	static Sched_Record one, hours, every_90, month, overdue, cancelled, late, random[SCHED_RANDOM];
+	Profile_Setup(100000);
+	DS3231_Emu_Advance(&emu, emu.next_tick_ns + 10 * 1000000ULL - emu.now_ns);
+	DS3231_SetEpoch(&rtc, SCHED_BASE);
+	DS3231_Emu_ResetCounters(&emu);
+	PROFILE("DS3231_SchedulerInit", DS3231_SchedulerInit(&sched, &rtc));
+	sched_pin = 1;
+
+	Sched_Start(&sched, &one, SCHED_BASE + 37, 0, 0);
+	Sched_Start(&sched, &hours, SCHED_BASE + 3600, 3600, 24); //hourly for a day
+	Sched_Start(&sched, &every_90, SCHED_BASE + 90, 90, 10);
+	Sched_Start(&sched, &month, SCHED_BASE + 40 * 86400, 0, 0); //11.03.: Alarm 1 also matches on 11.02.
+	Sched_Start(&sched, &overdue, SCHED_BASE - 5, 0, 0);
+	overdue.next = SCHED_BASE;
+	overdue.slack = 1;
+	uint32_t id = Sched_Start(&sched, &cancelled, SCHED_BASE + 600, 0, 0);
+	uint32_t seed = 12345;
+	for(int i = 0; i < SCHED_RANDOM; i++)
+	{
+		seed = seed * 1103515245U + 12345U;
+		Sched_Start(&sched, &random[i], SCHED_BASE + 1 + (seed >> 8) % (3 * 86400), 0, 0);
+	}
+	Check("TimerStart and TimerCancel stay off the bus", DS3231_TimerCancel(&sched, id) == 1 && emu.count.transactions == 0);
+
+	uint64_t seconds = (uint64_t)SCHED_DAYS * 86400;
+	uint32_t spurious = 0;
+	for(uint64_t s = 0; s < seconds; s++)
+	{
+		uint32_t wakeups = sched.wakeups;
+		uint32_t dispatched = sched.dispatched;
+		Sched_Sleep(&sched);
+		spurious += sched.wakeups != wakeups && sched.dispatched == dispatched && s > 0;
+	}
+	printf("%d days: %u dispatches in %u wakeups, %u transactions (polling DS3231_GetEpoch each second: %llu)\n", SCHED_DAYS,
+			(unsigned)sched.dispatched, (unsigned)sched.wakeups, (unsigned)emu.count.transactions, (unsigned long long)seconds);
+	uint32_t wrong = one.wrong + hours.wrong + every_90.wrong + month.wrong + overdue.wrong + cancelled.wrong;
+	uint32_t random_ok = 1;
+	for(int i = 0; i < SCHED_RANDOM; i++)
+	{
+		wrong += random[i].wrong;
+		random_ok &= random[i].count == 1;
+	}
+	Check("every dispatch in the second of its deadline", wrong == 0);
+	Check("one-shots once, periodic ones until they cancel themselves", one.count == 1 && hours.count == 24 && every_90.count == 10 &&
+			random_ok && overdue.count == 1 && cancelled.count == 0);
+	Check("40 days ahead: woken early on 11.02., dispatched on 11.03.", spurious == 1 && month.count == 1 && sched.count == 0);
+	Check("the MCU slept through all but a few hundred seconds", sched.wakeups < 200);
+
+	DS3231_Emu_Advance(&emu, emu.next_tick_ns - 1200000ULL - emu.now_ns); //1.2 ms before a seconds update: the alarm write lands after it
+	int64_t now = DS3231_BlockToEpoch(emu.regs);
+	Sched_Start(&sched, &late, now + 1, 0, 0);
+	DS3231_Emu_ResetCounters(&emu);
+	DS3231_SchedulerService(&sched);
+	Profile_Print("deadline with the next seconds update");
+	Check("alarm written after its match second: dispatched anyway", late.count == 1 && late.wrong == 0);
+	for(int s = 0; s < 5; s++)
+	{
+		Sched_Sleep(&sched);
+	}
+	Check("and not a second time", late.count == 1);
+}
+
+static void Section_Emulator(void) //the emulated part against the datasheet
+{
+	printf("////////////////// emulator //////////////////\n");
+	Profile_Setup(100000);
+
+	//rollover chain: 23:59:59 Sunday 31.12.(20)99 -> 00:00:00 Monday 01.01.(21)00
+	static const uint8_t nye[7] = {0x59, 0x59, 0x23, 0x07, 0x31, 0x12, 0x99};
+	Emu_Set(nye, DS3231_SECONDS_REG, sizeof(nye));
+	emu.next_tick_ns = emu.now_ns + DS3231_EMU_NS_PER_S;
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	static const uint8_t ny[7] = {0x00, 0x00, 0x00, 0x01, 0x01, 0x81, 0x00};
+	Check("seconds rollover through year, century bit toggles", memcmp(emu.regs, ny, sizeof(ny)) == 0);
+
+	//leap day: 28.02.24 -> 29.02.24, 28.02.23 -> 01.03.23
+	static const uint8_t leap[7] = {0x59, 0x59, 0x23, 0x03, 0x28, 0x02, 0x24};
+	Emu_Set(leap, DS3231_SECONDS_REG, sizeof(leap));
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	Check("28.02.24 rolls to 29.02.24", emu.regs[DS3231_DATE_REG] == 0x29 && emu.regs[DS3231_MONTH_REG] == 0x02);
+	Emu_Set(leap, DS3231_SECONDS_REG, sizeof(leap));
+	emu.regs[DS3231_YEAR_REG] = 0x23;
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	Check("28.02.23 rolls to 01.03.23", emu.regs[DS3231_DATE_REG] == 0x01 && emu.regs[DS3231_MONTH_REG] == 0x03);
+
+	//12 hour mode: 11:59:59 PM -> 12:00:00 AM and the next day
+	static const uint8_t pm[3] = {0x59, 0x59, 0x40 | 0x20 | 0x11};
+	Emu_Set(pm, DS3231_SECONDS_REG, sizeof(pm));
+	uint8_t date = emu.regs[DS3231_DATE_REG];
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	Check("11:59:59 PM rolls to 12:00:00 AM", emu.regs[DS3231_HOURS_REG] == (0x40 | 0x12) && emu.regs[DS3231_DATE_REG] == date + 1);
+
+	//writing seconds restarts the countdown: the next update is a full second after the write
+	uint8_t zero = 0;
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S / 2);
+	DS3231_WriteRegister(&rtc, DS3231_SECONDS_REG, &zero);
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S * 9 / 10);
+	Check("seconds write restarts the countdown chain", emu.regs[DS3231_SECONDS_REG] == 0x00);
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S / 10);
+	Check("first update one second after the write", emu.regs[DS3231_SECONDS_REG] == 0x01);
+
+	//alarm 1 once per second (all mask bits set), flags only clear on write
+	static const uint8_t every_s[4] = {0x80, 0x80, 0x80, 0x80};
+	Emu_Set(every_s, DS3231_ALARM1_SECONDS_REG, sizeof(every_s));
+	emu.regs[DS3231_CONTROL_REG] |= (1 << DS3231_A1IE) | (1 << DS3231_INTCN);
+	emu.regs[DS3231_CONTROL_STATUS_REG] = 0;
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	Check("alarm 1 every second sets A1F", DS_READ_BIT(emu.regs[DS3231_CONTROL_STATUS_REG],DS3231_A1F));
+	Check("A1F with A1IE and INTCN pulls INT low", DS3231_Emu_IntSqwPin(&emu) == 0);
+	uint8_t status = 0;
+	DS3231_WriteRegister(&rtc, DS3231_CONTROL_STATUS_REG, &status);
+	status = (1 << DS3231_A1F) | (1 << DS3231_A2F) | (1 << DS3231_OSF);
+	DS3231_WriteRegister(&rtc, DS3231_CONTROL_STATUS_REG, &status);
+	Check("writing 1 to OSF/A2F/A1F does not set them", (emu.regs[DS3231_CONTROL_STATUS_REG] & 0x83) == 0);
+
+	//alarm 2 on minutes match, 12 hour alarm against a 24 hour clock
+	static const uint8_t clock[3] = {0x58, 0x29, 0x14};
+	static const uint8_t alarm2[3] = {0x30, 0x40 | 0x20 | 0x02, 0x80};
+	Emu_Set(clock, DS3231_SECONDS_REG, sizeof(clock));
+	Emu_Set(alarm2, DS3231_ALARM2_MINUTES_REG, sizeof(alarm2));
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	Check("alarm 2 quiet before the minute", !DS_READ_BIT(emu.regs[DS3231_CONTROL_STATUS_REG],DS3231_A2F));
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	Check("alarm 2 at 14:30:00 matches 02:30 PM", DS_READ_BIT(emu.regs[DS3231_CONTROL_STATUS_REG],DS3231_A2F));
+
+	//CONV: BSY and CONV stay set for tCONV, then the new temperature is in 0x11-0x12
+	emu.temp_quarters = 21 * 4 + 3; //21.75 degC
+	uint8_t control = emu.regs[DS3231_CONTROL_REG] | (1 << DS3231_CONV);
+	DS3231_WriteRegister(&rtc, DS3231_CONTROL_REG, &control);
+	Check("CONV sets BSY", DS_READ_BIT(emu.regs[DS3231_CONTROL_STATUS_REG],DS3231_BSY));
+	DS3231_Emu_Advance(&emu, DS3231_EMU_CONV_NS);
+	DS3231_Get_Temp(&rtc);
+	Check("BSY and CONV clear after tCONV", !DS_READ_BIT(emu.regs[DS3231_CONTROL_STATUS_REG],DS3231_BSY) &&
+			!DS_READ_BIT(emu.regs[DS3231_CONTROL_REG],DS3231_CONV));
+	Check("temperature 21.75 degC reads back as 2175", rtc.temp == 2175);
+
+	//bus timing: a 1 byte read is 39 SCL clocks
+	Check("1 byte read takes 390 us at 100 kHz", DS3231_Emu_TransactionNs(&emu, 1, 1) == 390000);
+	emu.bus_hz = 400000;
+	Check("7 byte write takes 207.5 us at 400 kHz", DS3231_Emu_TransactionNs(&emu, 0, 7) == 207500);
+}
+
+static void Legacy_GetDateTime(DS3231* dev)
+{
+	DS3231_GetTime(dev);
+	DS3231_GetFullDate(dev);
+}
+
+static void Legacy_SetDateTime(DS3231* dev)
+{
+	DS3231_SetTime(dev, 59, 59, 23);
+	DS3231_SetFullDate(dev, 7, 31, 12, 99);
+}
+
+static int DateTime_Is(const DS3231* dev, const uint8_t* expect) //sec, min, hour, dow, date, month, year
+{
+	return dev->time[0] == expect[0] && dev->time[1] == expect[1] && dev->time[2] == expect[2] &&
+			dev->date[0] == expect[3] && dev->date[1] == expect[4] && dev->date[2] == expect[5] && dev->date[3] == expect[6];
+}
+
+static uint32_t DateTime_Torn(void (*get)(DS3231*), uint32_t bus_hz) //reads started every 10 us across a year rollover; counts mixed snapshots
+{
+	static const uint8_t nye[7] = {0x59, 0x59, 0x23, 0x07, 0x31, 0x12, 0x99};
+	static const uint8_t before[7] = {59, 59, 23, 7, 31, 12, 99};
+	static const uint8_t after[7] = {0, 0, 0, 1, 1, 1, 0};
+	uint32_t torn = 0;
+	for(uint64_t lead = 0; lead < 5000000ULL; lead += 10000ULL) //read starts 0-5 ms before the seconds update
+	{
+		Profile_Setup(bus_hz);
+		Emu_Set(nye, DS3231_SECONDS_REG, sizeof(nye));
+		emu.next_tick_ns = emu.now_ns + lead;
+		get(&rtc);
+		if(!DateTime_Is(&rtc, before) && !DateTime_Is(&rtc, after))
+		{
+			torn++;
+		}
+	}
+	return torn;
+}
+
+static void Section_DateTime(void) //one burst against GetTime + GetFullDate
+{
+	printf("////////////////// date and time read //////////////////\n");
+	Profile_Setup(100000);
+	DS3231_Emu_ResetCounters(&emu);
+	Legacy_GetDateTime(&rtc);
+	uint64_t legacy_ns = emu.count.bus_ns;
+	Profile_Print("DS3231_GetTime + DS3231_GetFullDate");
+	DS3231_GetDateTime(&rtc);
+	uint64_t burst_ns = emu.count.bus_ns;
+	Check("DS3231_GetDateTime is one 7 byte transaction", emu.count.transactions == 1 && emu.count.bytes == 7);
+	printf("bus time ratio at 100 kHz: %.2fx\n", (double)legacy_ns / burst_ns);
+
+	static const uint8_t pm[7] = {0x05, 0x30, 0x40 | 0x20 | 0x12, 0x02, 0x29, 0x02, 0x24}; //12:30:05 PM Mon 29.02.24
+	static const uint8_t pm_dec[7] = {5, 30, 12, 2, 29, 2, 24};
+	Emu_Set(pm, DS3231_SECONDS_REG, sizeof(pm));
+	DS3231_GetDateTime(&rtc);
+	Check("12:30:05 PM decodes to 12:30:05", DateTime_Is(&rtc, pm_dec));
+	emu.regs[DS3231_HOURS_REG] = 0x40 | 0x12; //12 AM
+	DS3231_GetDateTime(&rtc);
+	Check("12 AM decodes to hour 0", rtc.time[2] == 0);
+	emu.regs[DS3231_HOURS_REG] = 0x40 | 0x20 | 0x11; //11 PM
+	DS3231_GetDateTime(&rtc);
+	Check("11 PM decodes to hour 23", rtc.time[2] == 23);
+	emu.regs[DS3231_HOURS_REG] = 0x19; //19 in 24 hour mode
+	DS3231_GetHours(&rtc);
+	Check("DS3231_GetHours keeps the 10 hour bit (19)", rtc.time[2] == 19);
+
+	uint32_t legacy_torn = DateTime_Torn(Legacy_GetDateTime, 100000);
+	uint32_t burst_torn = DateTime_Torn(DS3231_GetDateTime, 100000);
+	printf("torn snapshots across a rollover (500 reads, 0-5 ms ahead of it): legacy %u, burst %u\n",
+			(unsigned)legacy_torn, (unsigned)burst_torn);
+	Check("DS3231_GetDateTime never tears", burst_torn == 0);
+
+	printf("////////////////// date and time write //////////////////\n");
+	Profile_Setup(100000);
+	PROFILE("DS3231_SetTime + DS3231_SetFullDate", Legacy_SetDateTime(&rtc));
+	PROFILE("DS3231_SetDateTime", DS3231_SetDateTime(&rtc, 59, 59, 23, 7, 31, 12, 99));
+	Profile_Setup(100000);
+	DS3231_SetDateTime(&rtc, 59, 59, 23, 7, 31, 12, 99);
+	Check("DS3231_SetDateTime is one read and one 7 byte write", emu.count.transactions == 2 && emu.count.writes == 1 && emu.count.bytes == 8);
+	static const uint8_t nye[7] = {0x59, 0x59, 0x23, 0x07, 0x31, 0x12, 0x99};
+	Check("23:59:59 Sun 31.12.99 lands in 0x00-0x06", memcmp(emu.regs, nye, sizeof(nye)) == 0);
+	Check("countdown restarts at the end of the burst", emu.next_tick_ns == emu.now_ns + DS3231_EMU_NS_PER_S);
+	DS3231_Emu_Advance(&emu, DS3231_EMU_NS_PER_S);
+	Check("one second later it is 00:00:00 01.01.00, century set", emu.regs[DS3231_HOURS_REG] == 0x00 && emu.regs[DS3231_YEAR_REG] == 0x00 &&
+			emu.regs[DS3231_MONTH_REG] == (0x80 | 0x01));
+	DS3231_SetDateTime(&rtc, 0, 0, 12, 1, 1, 6, 50);
+	Check("century bit kept", emu.regs[DS3231_MONTH_REG] == (0x80 | 0x06));
+	DS3231_SetHourMode(&rtc, Hour_12_AM_PM);
+	Check("DS3231_SetHourMode converts 12:00 to 12 PM", emu.regs[DS3231_HOURS_REG] == (0x40 | 0x20 | 0x12));
+	DS3231_SetDateTime(&rtc, 0, 15, 0, 1, 1, 6, 50);
+	Check("12 hour mode kept, hour 0 written as 12 AM", emu.regs[DS3231_HOURS_REG] == (0x40 | 0x12));
+	DS3231_SetDateTime(&rtc, 0, 15, 13, 1, 1, 6, 50);
+	Check("hour 13 written as 01 PM", emu.regs[DS3231_HOURS_REG] == (0x40 | 0x20 | 0x01));
+	DS3231_SetHours(&rtc, 9);
+	Check("DS3231_SetHours clears PM for 9 AM", emu.regs[DS3231_HOURS_REG] == (0x40 | 0x09));
+}
+
+
+int main(int argc, char* argv[])
+{
+	const char* section = argc > 1 ? argv[1] : NULL;
+	int ran = 0;
+	if(section == NULL || strcmp(section, "traffic") == 0)
+	{
+		Section_Traffic();
+		ran++;
+	}
+	if(section == NULL || strcmp(section, "datetime") == 0)
+	{
+		Section_DateTime();
+		ran++;
+	}
+	if(section == NULL || strcmp(section, "cache") == 0)
+	{
+		Section_Cache();
+		ran++;
+	}
+	if(section == NULL || strcmp(section, "config") == 0)
+	{
+		Section_Config();
+		ran++;
+	}
+	if(section == NULL || strcmp(section, "async") == 0)
+	{
+		Section_Async();
+		ran++;
+	}
+	if(section == NULL || strcmp(section, "faults") == 0)
+	{
+		Section_Faults();
+		ran++;
+	}
+	if(section == NULL || strcmp(section, "softclock") == 0)
+	{
+		Section_SoftClock();
+		ran++;
+	}
+	if(section == NULL || strcmp(section, "calendar") == 0)
+	{
+		Section_Calendar();
+		ran++;
+	}
+	if(section == NULL || strcmp(section, "scheduler") == 0)
+	{
+		Section_Scheduler();
+		ran++;
+	}
+	if(section == NULL || strcmp(section, "emulator") == 0)
+	{
+		Section_Emulator();
+		ran++;
+	}
+	if(ran == 0)
+	{
+		fprintf(stderr, "Unknown section: %s\n", section);
+		return 1;
+	}
+	if(failures)
+	{
+		printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
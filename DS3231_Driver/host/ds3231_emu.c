@@ -0,0 +1,323 @@
+/*
+ * ds3231_emu.c
+ *
+ *  Register-level DS3231 emulator for host builds of the driver.
+ *  Modeled after the datasheet (19-5170): countdown chain with 12/24 h and century handling, both alarms,
+ *  OSF/A1F/A2F/BSY semantics, TCXO conversions and the bus time of each transaction at the configured SCL rate.
+ *  The part is modeled as running from VCC, so EOSC does not stop the oscillator.
+ */
+#include <string.h>
+
+#include "ds3231_emu.h"
+#include "DS3231_Driver.h"
+
+
+//Helper Functions
+static uint8_t Emu_ToDec(uint8_t bcd)
+{
+	return ((bcd >> 4) * 10) + (bcd & 0x0F);
+}
+
+static uint8_t Emu_ToBCD(uint8_t dec)
+{
+	return ((dec / 10) << 4) | (dec % 10);
+}
+
+static uint8_t Emu_Hour24(uint8_t reg) //hours register (time or alarm) as 0-23
+{
+	if(DS_READ_BIT(reg,DS3231_12_24))
+	{
+		uint8_t hour = Emu_ToDec(reg & 0x1F) % 12;
+		return DS_READ_BIT(reg,DS3231_AM_PM_20_HOUR) ? hour + 12 : hour;
+	}
+	return Emu_ToDec(reg & 0x3F);
+}
+
+static uint8_t Emu_EncodeHour(uint8_t reg, uint8_t hour24) //keeps the 12/24 mode of reg
+{
+	if(DS_READ_BIT(reg,DS3231_12_24))
+	{
+		uint8_t hour12 = hour24 % 12;
+		if(hour12 == 0)
+		{
+			hour12 = 12;
+		}
+		return (1 << DS3231_12_24) | ((hour24 >= 12) << DS3231_AM_PM_20_HOUR) | Emu_ToBCD(hour12);
+	}
+	return Emu_ToBCD(hour24);
+}
+
+static uint8_t Emu_DaysInMonth(uint8_t month, uint8_t year)
+{
+	static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	if(month == 2 && (year % 4) == 0) //the part treats every fourth year as leap, which holds until 2100
+	{
+		return 29;
+	}
+	return (month >= 1 && month <= 12) ? days[month - 1] : 31;
+}
+
+
+//Countdown Chain
+static void Emu_NextDay(DS3231_Emu* emu)
+{
+	uint8_t* r = emu->regs;
+	uint8_t dow = r[DS3231_DAY_OF_WEEK_REG] & 0x07;
+	r[DS3231_DAY_OF_WEEK_REG] = (dow >= 7) ? 1 : dow + 1;
+
+	uint8_t century = r[DS3231_MONTH_REG] & 0x80;
+	uint8_t month = Emu_ToDec(r[DS3231_MONTH_REG] & 0x1F);
+	uint8_t year = Emu_ToDec(r[DS3231_YEAR_REG]);
+	uint8_t date = Emu_ToDec(r[DS3231_DATE_REG] & 0x3F) + 1;
+	if(date > Emu_DaysInMonth(month, year))
+	{
+		date = 1;
+		month++;
+		if(month > 12)
+		{
+			month = 1;
+			year++;
+			if(year > 99) //year 99 -> 00 toggles the century bit
+			{
+				year = 0;
+				century ^= 0x80;
+			}
+		}
+	}
+	r[DS3231_DATE_REG] = Emu_ToBCD(date);
+	r[DS3231_MONTH_REG] = century | Emu_ToBCD(month);
+	r[DS3231_YEAR_REG] = Emu_ToBCD(year);
+}
+
+static uint8_t Emu_AlarmDayMatch(const uint8_t* r, uint8_t reg)
+{
+	if(DS_READ_BIT(r[reg],DS3231_DY_DT))
+	{
+		return (r[reg] & 0x0F) == (r[DS3231_DAY_OF_WEEK_REG] & 0x07);
+	}
+	return (r[reg] & 0x3F) == (r[DS3231_DATE_REG] & 0x3F);
+}
+
+static void Emu_CheckAlarms(DS3231_Emu* emu)
+{
+	uint8_t* r = emu->regs;
+	uint8_t hour = Emu_Hour24(r[DS3231_HOURS_REG]);
+
+	//Alarm 1 is compared on every seconds update
+	if((DS_READ_BIT(r[DS3231_ALARM1_SECONDS_REG],DS3231_A1M1) || (r[DS3231_ALARM1_SECONDS_REG] & 0x7F) == r[DS3231_SECONDS_REG]) &&
+	   (DS_READ_BIT(r[DS3231_ALARM1_MINUTES_REG],DS3231_A1M2) || (r[DS3231_ALARM1_MINUTES_REG] & 0x7F) == r[DS3231_MINUTES_REG]) &&
+	   (DS_READ_BIT(r[DS3231_ALARM1_HOURS_REG],DS3231_A1M3) || Emu_Hour24(r[DS3231_ALARM1_HOURS_REG] & 0x7F) == hour) &&
+	   (DS_READ_BIT(r[DS3231_ALARM1_DAY_DATE_REG],DS3231_A1M4) || Emu_AlarmDayMatch(r, DS3231_ALARM1_DAY_DATE_REG)))
+	{
+		DS_SET_BIT(r[DS3231_CONTROL_STATUS_REG],DS3231_A1F);
+	}
+
+	//Alarm 2 has no seconds register and is compared once per minute
+	if(r[DS3231_SECONDS_REG] == 0 &&
+	   (DS_READ_BIT(r[DS3231_ALARM2_MINUTES_REG],DS3231_A2M2) || (r[DS3231_ALARM2_MINUTES_REG] & 0x7F) == r[DS3231_MINUTES_REG]) &&
+	   (DS_READ_BIT(r[DS3231_ALARM2_HOURS_REG],DS3231_A2M3) || Emu_Hour24(r[DS3231_ALARM2_HOURS_REG] & 0x7F) == hour) &&
+	   (DS_READ_BIT(r[DS3231_ALARM2_DAY_DATE_REG],DS3231_A2M4) || Emu_AlarmDayMatch(r, DS3231_ALARM2_DAY_DATE_REG)))
+	{
+		DS_SET_BIT(r[DS3231_CONTROL_STATUS_REG],DS3231_A2F);
+	}
+}
+
+static void Emu_StartConversion(DS3231_Emu* emu)
+{
+	if(emu->conv_done_ns == 0)
+	{
+		DS_SET_BIT(emu->regs[DS3231_CONTROL_STATUS_REG],DS3231_BSY);
+		emu->conv_done_ns = emu->now_ns + DS3231_EMU_CONV_NS;
+	}
+}
+
+static void Emu_Tick(DS3231_Emu* emu) //one seconds update of the countdown chain
+{
+	uint8_t* r = emu->regs;
+	uint8_t sec = Emu_ToDec(r[DS3231_SECONDS_REG] & 0x7F) + 1;
+	if(sec > 59)
+	{
+		sec = 0;
+		uint8_t min = Emu_ToDec(r[DS3231_MINUTES_REG] & 0x7F) + 1;
+		if(min > 59)
+		{
+			min = 0;
+			uint8_t hour = (Emu_Hour24(r[DS3231_HOURS_REG]) + 1) % 24;
+			r[DS3231_HOURS_REG] = Emu_EncodeHour(r[DS3231_HOURS_REG], hour);
+			if(hour == 0)
+			{
+				Emu_NextDay(emu);
+			}
+		}
+		r[DS3231_MINUTES_REG] = Emu_ToBCD(min);
+	}
+	r[DS3231_SECONDS_REG] = Emu_ToBCD(sec);
+
+	Emu_CheckAlarms(emu);
+
+	if(--emu->seconds_to_tcxo == 0)
+	{
+		emu->seconds_to_tcxo = DS3231_EMU_TCXO_S;
+		Emu_StartConversion(emu);
+	}
+}
+
+static void Emu_FinishConversion(DS3231_Emu* emu)
+{
+	emu->regs[DS3231_TEMPERATURE_MSB_REG] = (uint8_t)(emu->temp_quarters >> 2);
+	emu->regs[DS3231_TEMPERATURE_LSB_REG] = (uint8_t)((emu->temp_quarters & 0x03) << 6);
+	DS_CLEAR_BIT(emu->regs[DS3231_CONTROL_STATUS_REG],DS3231_BSY);
+	DS_CLEAR_BIT(emu->regs[DS3231_CONTROL_REG],DS3231_CONV);
+	emu->conv_done_ns = 0;
+}
+
+
+//Setup Functions
+void DS3231_Emu_Init(DS3231_Emu* emu, uint32_t bus_hz)
+{
+	memset(emu, 0, sizeof(*emu));
+	emu->bus_hz = bus_hz;
+
+	emu->regs[DS3231_DAY_OF_WEEK_REG] = 0x01;
+	emu->regs[DS3231_DATE_REG] = 0x01;
+	emu->regs[DS3231_MONTH_REG] = 0x01;
+	emu->regs[DS3231_CONTROL_REG] = (1 << DS3231_RS_2) | (1 << DS3231_RS_1) | (1 << DS3231_INTCN);
+	emu->regs[DS3231_CONTROL_STATUS_REG] = (1 << DS3231_OSF) | (1 << DS3231_EN32kHz);
+
+	emu->temp_quarters = 25 * 4;
+	emu->next_tick_ns = DS3231_EMU_NS_PER_S;
+	emu->seconds_to_tcxo = DS3231_EMU_TCXO_S;
+	Emu_FinishConversion(emu); //power-on conversion
+}
+
+void DS3231_Emu_ResetCounters(DS3231_Emu* emu)
+{
+	memset(&emu->count, 0, sizeof(emu->count));
+}
+
+
+//Time Functions
+void DS3231_Emu_Advance(DS3231_Emu* emu, uint64_t ns)
+{
+	uint64_t target = emu->now_ns + ns;
+	for(;;)
+	{
+		uint64_t next = emu->next_tick_ns;
+		if(emu->conv_done_ns != 0 && emu->conv_done_ns < next)
+		{
+			next = emu->conv_done_ns;
+		}
+		if(next > target)
+		{
+			break;
+		}
+		emu->now_ns = next;
+		if(next == emu->conv_done_ns)
+		{
+			Emu_FinishConversion(emu);
+		}
+		if(next == emu->next_tick_ns)
+		{
+			emu->next_tick_ns += DS3231_EMU_NS_PER_S;
+			Emu_Tick(emu);
+			uint8_t control = emu->regs[DS3231_CONTROL_REG];
+			if(emu->sqw_edge && !DS_READ_BIT(control,DS3231_INTCN) && ((control >> DS3231_RS_1) & 0x03) == 0) //1 Hz falls with the seconds update
+			{
+				emu->sqw_edge(emu->sqw_context);
+			}
+		}
+	}
+	emu->now_ns = target;
+}
+
+
+//Bus Functions
+uint64_t DS3231_Emu_TransactionNs(const DS3231_Emu* emu, uint8_t read, uint16_t length)
+{
+	//write: S, address+W, pointer, data..., P; read adds Sr and address+R before the data. 9 clocks per byte incl. ACK
+	uint32_t clocks = read ? (3 * 9 + 9 * length + 3) : (2 * 9 + 9 * length + 2);
+	return (uint64_t)clocks * DS3231_EMU_NS_PER_S / emu->bus_hz;
+}
+
+uint8_t DS3231_Emu_Read(DS3231_Emu* emu, uint8_t reg, uint8_t* data, uint16_t length)
+{
+	if(reg >= DS3231_EMU_REGS)
+	{
+		return 1;
+	}
+	//time registers are copied to a secondary buffer on START, so one burst is always coherent
+	for(uint16_t i = 0; i < length; i++)
+	{
+		data[i] = emu->regs[(reg + i) % DS3231_EMU_REGS]; //the register pointer wraps from 0x12 to 0x00
+	}
+	uint64_t ns = DS3231_Emu_TransactionNs(emu, 1, length);
+	emu->count.transactions++;
+	emu->count.reads++;
+	emu->count.bytes += length;
+	emu->count.bus_ns += ns;
+	DS3231_Emu_Advance(emu, ns);
+	return 0;
+}
+
+uint8_t DS3231_Emu_Write(DS3231_Emu* emu, uint8_t reg, const uint8_t* data, uint16_t length)
+{
+	static const uint8_t writable[DS3231_EMU_REGS] = {
+		0x7F, 0x7F, 0x7F, 0x07, 0x3F, 0x9F, 0xFF, //time and date
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, //alarms
+		0xFF, 0x00, 0xFF, 0x00, 0x00 //control, status (below), aging offset, temperature
+	};
+	if(reg >= DS3231_EMU_REGS)
+	{
+		return 1;
+	}
+	uint64_t ns = DS3231_Emu_TransactionNs(emu, 0, length);
+	emu->count.transactions++;
+	emu->count.writes++;
+	emu->count.bytes += length;
+	emu->count.bus_ns += ns;
+	DS3231_Emu_Advance(emu, ns);
+
+	for(uint16_t i = 0; i < length; i++)
+	{
+		uint8_t r = (reg + i) % DS3231_EMU_REGS;
+		uint8_t value = data[i];
+		if(r == DS3231_CONTROL_STATUS_REG)
+		{
+			//OSF, A2F and A1F can only be cleared, BSY is read-only, EN32kHz is plain R/W
+			uint8_t keep = emu->regs[r] & value & ((1 << DS3231_OSF) | (1 << DS3231_A2F) | (1 << DS3231_A1F));
+			emu->regs[r] = keep | (emu->regs[r] & (1 << DS3231_BSY)) | (value & (1 << DS3231_EN32kHz));
+			continue;
+		}
+		emu->regs[r] = value & writable[r];
+		if(r == DS3231_SECONDS_REG) //writing the seconds register restarts the countdown chain
+		{
+			emu->next_tick_ns = emu->now_ns + DS3231_EMU_NS_PER_S;
+		}
+		if(r == DS3231_CONTROL_REG && DS_READ_BIT(value,DS3231_CONV))
+		{
+			Emu_StartConversion(emu);
+		}
+	}
+	return 0;
+}
+
+
+//Pin Functions
+uint8_t DS3231_Emu_IntSqwPin(const DS3231_Emu* emu)
+{
+	const uint8_t* r = emu->regs;
+	if(DS_READ_BIT(r[DS3231_CONTROL_REG],DS3231_INTCN))
+	{
+		uint8_t a1 = DS_READ_BIT(r[DS3231_CONTROL_STATUS_REG],DS3231_A1F) && DS_READ_BIT(r[DS3231_CONTROL_REG],DS3231_A1IE);
+		uint8_t a2 = DS_READ_BIT(r[DS3231_CONTROL_STATUS_REG],DS3231_A2F) && DS_READ_BIT(r[DS3231_CONTROL_REG],DS3231_A2IE);
+		return !(a1 || a2);
+	}
+	static const uint32_t rates[4] = {1, 1024, 4096, 8192};
+	uint32_t rate = rates[(r[DS3231_CONTROL_REG] >> DS3231_RS_1) & 0x03];
+	if(rate == 1) //the falling edge of the 1 Hz output coincides with the seconds update
+	{
+		return (emu->next_tick_ns - emu->now_ns) <= DS3231_EMU_NS_PER_S / 2;
+	}
+	uint64_t period = DS3231_EMU_NS_PER_S / rate;
+	return (emu->now_ns % period) >= period / 2;
+}
@@ -0,0 +1,60 @@
+/*
+ * ds3231_emu.h
+ *
+ *  Register-level DS3231 emulator for host builds of the driver.
+ *  Time only moves when the emulator is told so: by DS3231_Emu_Advance() or by the bus time of a transaction.
+ */
+
+#ifndef DS3231_EMU_H_
+#define DS3231_EMU_H_
+
+#include <stdint.h>
+
+#define DS3231_EMU_REGS 0x13
+
+#define DS3231_EMU_NS_PER_S 1000000000ULL
+#define DS3231_EMU_CONV_NS (200ULL * 1000000ULL) //tCONV max; BSY/CONV stay set this long
+#define DS3231_EMU_TCXO_S 64 //automatic temperature conversion interval
+
+
+//Bus counters
+typedef struct DS3231_EmuCounters{
+	uint32_t transactions;
+	uint32_t reads;
+	uint32_t writes;
+	uint32_t bytes; //register bytes moved, without address and pointer bytes
+	uint64_t bus_ns; //time the bus was busy
+}DS3231_EmuCounters;
+
+
+//Emulator State
+typedef struct DS3231_Emu{
+	uint8_t regs[DS3231_EMU_REGS];
+	uint32_t bus_hz; //SCL frequency, 100000 or 400000
+	uint64_t now_ns; //simulated time
+	uint64_t next_tick_ns; //next seconds update of the countdown chain
+	uint64_t conv_done_ns; //end of the running temperature conversion, 0 if none
+	uint32_t seconds_to_tcxo; //seconds until the next automatic conversion
+	int16_t temp_quarters; //die temperature in 0.25 degC steps, loaded into 0x11-0x12 by each conversion
+	DS3231_EmuCounters count;
+	void (*sqw_edge)(void* context); //called at each falling edge of the 1 Hz square wave (INTCN = 0, RS = 1 Hz), like an EXTI interrupt
+	void* sqw_context;
+}DS3231_Emu;
+
+
+//Setup Functions
+void DS3231_Emu_Init(DS3231_Emu* emu, uint32_t bus_hz); //power-on-reset register values, time 00:00:00 01.01.00
+void DS3231_Emu_ResetCounters(DS3231_Emu* emu);
+
+//Time Functions
+void DS3231_Emu_Advance(DS3231_Emu* emu, uint64_t ns); //runs the countdown chain, alarms and conversions forward
+
+//Bus Functions (one call = one I2C transaction, which also advances time by its duration)
+uint8_t DS3231_Emu_Read(DS3231_Emu* emu, uint8_t reg, uint8_t* data, uint16_t length);
+uint8_t DS3231_Emu_Write(DS3231_Emu* emu, uint8_t reg, const uint8_t* data, uint16_t length);
+uint64_t DS3231_Emu_TransactionNs(const DS3231_Emu* emu, uint8_t read, uint16_t length);
+
+//Pin Functions
+uint8_t DS3231_Emu_IntSqwPin(const DS3231_Emu* emu); //level of INT/SQW (open drain: 0 = asserted / low)
+
+#endif /* DS3231_EMU_H_ */
@@ -0,0 +1,330 @@
+/*
+ * hal_host.c
+ *
+ *  HAL_I2C_Mem_* calls served by the DS3231 emulator. Simulated time is the emulator's:
+ *  every transfer advances it by its bus time, HAL_Delay() by the requested milliseconds.
+ *  The _IT/_DMA variants return at once; a second thread sleeps for the bus time in real time,
+ *  runs the transfer and calls the completion callback, the way the I2C interrupt would.
+ *  That thread holds host_irq while it runs, so __disable_irq() keeps it out.
+ *  PRIMASK is a per-thread bit: set, the thread holds one level of host_irq; the HAL's own bookkeeping takes
+ *  further levels through Host_Lock(), so it never unmasks a caller's critical section.
+ */
+#include <pthread.h>
+#include <time.h>
+
+#include "stm32l4xx_hal.h"
+#include "ds3231_emu.h"
+#include "DS3231_Driver.h"
+
+
+static DS3231_Emu* host_clock; //device whose simulated time HAL_GetTick() reports
+
+static pthread_mutex_t host_irq; //recursive: held by the interrupt thread, by __disable_irq() and by Host_Lock()
+static __thread uint32_t host_primask; //this thread's PRIMASK
+static pthread_cond_t host_kick = PTHREAD_COND_INITIALIZER;
+static pthread_once_t host_once = PTHREAD_ONCE_INIT;
+static struct{
+	I2C_HandleTypeDef* hi2c;
+	uint8_t read;
+	uint8_t reg;
+	uint8_t* data;
+	uint16_t size;
+	uint8_t pending;
+}host_xfer; //the one transfer on the bus
+
+static uint32_t host_nacks; //injected faults
+static uint8_t host_sda_stuck;
+
+
+static HAL_StatusTypeDef Host_Fault(I2C_HandleTypeDef* hi2c, uint32_t Timeout) //interrupts off: an injected fault for this transfer, if any
+{
+	DS3231_Emu* emu = hi2c->Instance;
+	if(host_sda_stuck) //the HAL waits for the bus until the timeout runs out
+	{
+		DS3231_Emu_Advance(emu, (uint64_t)Timeout * 1000000ULL);
+		return HAL_TIMEOUT;
+	}
+	if(host_nacks > 0) //START + address byte, then no ACK
+	{
+		host_nacks--;
+		DS3231_Emu_Advance(emu, 10ULL * DS3231_EMU_NS_PER_S / emu->bus_hz);
+		hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+		return HAL_ERROR;
+	}
+	return HAL_OK;
+}
+
+
+static void* Host_IrqThread(void* arg)
+{
+	(void)arg;
+	pthread_mutex_lock(&host_irq);
+	for(;;)
+	{
+		while(!host_xfer.pending)
+		{
+			pthread_cond_wait(&host_kick, &host_irq);
+		}
+		I2C_HandleTypeDef* hi2c = host_xfer.hi2c;
+		uint64_t ns = DS3231_Emu_TransactionNs(hi2c->Instance, host_xfer.read, host_xfer.size);
+		struct timespec bus = {(time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL)};
+		pthread_mutex_unlock(&host_irq); //the bus is busy, the CPU is not
+		nanosleep(&bus, NULL);
+		pthread_mutex_lock(&host_irq);
+
+		uint8_t failed = Host_Fault(hi2c, 0) != HAL_OK || (host_xfer.read ? DS3231_Emu_Read(hi2c->Instance, host_xfer.reg, host_xfer.data, host_xfer.size)
+				: DS3231_Emu_Write(hi2c->Instance, host_xfer.reg, host_xfer.data, host_xfer.size));
+		uint8_t read = host_xfer.read;
+		host_xfer.pending = 0;
+		hi2c->ErrorCode = failed ? HAL_I2C_ERROR_AF : HAL_I2C_ERROR_NONE;
+		if(failed)
+		{
+			HAL_I2C_ErrorCallback(hi2c);
+		}
+		else if(read)
+		{
+			HAL_I2C_MemRxCpltCallback(hi2c);
+		}
+		else
+		{
+			HAL_I2C_MemTxCpltCallback(hi2c);
+		}
+	}
+	return NULL;
+}
+
+static void Host_IrqSetup(void)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&host_irq, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, Host_IrqThread, NULL);
+	pthread_detach(thread);
+}
+
+static void Host_Lock(void) //the HAL's own critical sections, independent of PRIMASK
+{
+	pthread_once(&host_once, Host_IrqSetup);
+	pthread_mutex_lock(&host_irq);
+}
+
+static void Host_Unlock(void)
+{
+	pthread_mutex_unlock(&host_irq);
+}
+
+static HAL_StatusTypeDef Host_Start(I2C_HandleTypeDef* hi2c, uint8_t read, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size)
+{
+	if(hi2c == NULL || hi2c->Instance == NULL || pData == NULL || Size == 0 || MemAddSize != I2C_MEMADD_SIZE_8BIT || DevAddress != DS3231_I2C_ADDRESS)
+	{
+		return HAL_ERROR;
+	}
+	Host_Lock();
+	HAL_StatusTypeDef status = HAL_BUSY;
+	if(!host_xfer.pending)
+	{
+		host_xfer.hi2c = hi2c;
+		host_xfer.read = read;
+		host_xfer.reg = (uint8_t)MemAddress;
+		host_xfer.data = pData;
+		host_xfer.size = Size;
+		host_xfer.pending = 1;
+		pthread_cond_signal(&host_kick);
+		status = HAL_OK;
+	}
+	Host_Unlock();
+	return status;
+}
+
+
+//HAL Functions
+uint32_t HAL_GetTick(void)
+{
+	return host_clock ? (uint32_t)(host_clock->now_ns / 1000000ULL) : 0;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	if(host_clock)
+	{
+		Host_Lock();
+		DS3231_Emu_Advance(host_clock, (uint64_t)Delay * 1000000ULL);
+		Host_Unlock();
+	}
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+	if(hi2c == NULL || hi2c->Instance == NULL || pData == NULL || Size == 0 || MemAddSize != I2C_MEMADD_SIZE_8BIT)
+	{
+		return HAL_ERROR;
+	}
+	if(DevAddress != DS3231_I2C_ADDRESS)
+	{
+		hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+		return HAL_ERROR;
+	}
+	Host_Lock();
+	if(host_xfer.pending) //a non-blocking transfer owns the bus
+	{
+		Host_Unlock();
+		return HAL_BUSY;
+	}
+	HAL_StatusTypeDef fault = Host_Fault(hi2c, Timeout);
+	if(fault != HAL_OK)
+	{
+		Host_Unlock();
+		return fault;
+	}
+	uint8_t failed = DS3231_Emu_Read(hi2c->Instance, (uint8_t)MemAddress, pData, Size) != 0;
+	Host_Unlock();
+	if(failed)
+	{
+		hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+		return HAL_ERROR;
+	}
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size)
+{
+	return Host_Start(hi2c, 1, DevAddress, MemAddress, MemAddSize, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size)
+{
+	return Host_Start(hi2c, 1, DevAddress, MemAddress, MemAddSize, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+	if(hi2c == NULL || hi2c->Instance == NULL || pData == NULL || Size == 0 || MemAddSize != I2C_MEMADD_SIZE_8BIT)
+	{
+		return HAL_ERROR;
+	}
+	if(DevAddress != DS3231_I2C_ADDRESS)
+	{
+		hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+		return HAL_ERROR;
+	}
+	Host_Lock();
+	if(host_xfer.pending) //a non-blocking transfer owns the bus
+	{
+		Host_Unlock();
+		return HAL_BUSY;
+	}
+	HAL_StatusTypeDef fault = Host_Fault(hi2c, Timeout);
+	if(fault != HAL_OK)
+	{
+		Host_Unlock();
+		return fault;
+	}
+	uint8_t failed = DS3231_Emu_Write(hi2c->Instance, (uint8_t)MemAddress, pData, Size) != 0;
+	Host_Unlock();
+	if(failed)
+	{
+		hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+		return HAL_ERROR;
+	}
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size)
+{
+	return Host_Start(hi2c, 0, DevAddress, MemAddress, MemAddSize, pData, Size);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size)
+{
+	return Host_Start(hi2c, 0, DevAddress, MemAddress, MemAddSize, pData, Size);
+}
+
+
+__attribute__((weak)) void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+	(void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+	(void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+	(void)hi2c;
+}
+
+
+//CMSIS
+void __disable_irq(void)
+{
+	if(!host_primask)
+	{
+		Host_Lock();
+		host_primask = 1;
+	}
+}
+
+void __enable_irq(void)
+{
+	if(host_primask)
+	{
+		host_primask = 0;
+		Host_Unlock();
+	}
+}
+
+uint32_t __get_PRIMASK(void)
+{
+	return host_primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+	if(priMask & 1)
+	{
+		__disable_irq();
+	}
+	else
+	{
+		__enable_irq();
+	}
+}
+
+
+//Host Functions
+void HAL_Host_Attach(I2C_HandleTypeDef* hi2c, struct DS3231_Emu* emu)
+{
+	hi2c->Instance = emu;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	host_clock = emu;
+}
+
+uint32_t HAL_Host_Micros(void)
+{
+	return host_clock ? (uint32_t)(host_clock->now_ns / 1000ULL) : 0;
+}
+
+void HAL_Host_InjectFaults(uint32_t nacks, uint8_t sda_stuck)
+{
+	Host_Lock();
+	host_nacks = nacks;
+	host_sda_stuck = sda_stuck;
+	Host_Unlock();
+}
+
+void HAL_Host_BusRecover(I2C_HandleTypeDef* hi2c)
+{
+	DS3231_Emu* emu = hi2c->Instance;
+	Host_Lock();
+	host_sda_stuck = 0; //the part finishes the byte it was sending and sees the STOP
+	DS3231_Emu_Advance(emu, 10ULL * DS3231_EMU_NS_PER_S / emu->bus_hz);
+	Host_Unlock();
+}
@@ -0,0 +1,74 @@
+/*
+ * stm32l4xx_hal.h
+ *
+ *  Host stand-in for the STM32L4 HAL: just the types and calls DS3231_Driver.c uses,
+ *  backed by the DS3231 emulator (hal_host.c, ds3231_emu.c) instead of an I2C peripheral.
+ */
+
+#ifndef STM32L4XX_HAL_H_
+#define STM32L4XX_HAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+#define I2C_MEMADD_SIZE_8BIT 0x00000001U
+
+#define HAL_I2C_ERROR_NONE 0x00000000U
+#define HAL_I2C_ERROR_AF 0x00000004U //no acknowledge
+
+
+typedef enum{
+	HAL_OK = 0x00U, HAL_ERROR = 0x01U, HAL_BUSY = 0x02U, HAL_TIMEOUT = 0x03U
+}HAL_StatusTypeDef;
+
+typedef struct __I2C_HandleTypeDef{
+	void* Instance; //host: the emulated device on this bus (struct DS3231_Emu*)
+	uint32_t ErrorCode;
+}I2C_HandleTypeDef;
+
+
+//HAL Functions
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+
+//Non-blocking transfers: host completes them on a separate thread, which stands in for the I2C interrupt
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size);
+
+//Weak callbacks, overridden by the application
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c);
+
+//CMSIS: host masks the interrupt thread instead of PRIMASK; each thread keeps its own PRIMASK bit
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+#define __DMB() __sync_synchronize()
+
+
+//Host Functions
+struct DS3231_Emu;
+void HAL_Host_Attach(I2C_HandleTypeDef* hi2c, struct DS3231_Emu* emu); //also makes emu the clock behind HAL_GetTick()
+uint32_t HAL_Host_Micros(void); //simulated time in us
+void HAL_Host_InjectFaults(uint32_t nacks, uint8_t sda_stuck); //the next nacks transfers are not acknowledged; SDA stuck: every transfer times out
+void HAL_Host_BusRecover(I2C_HandleTypeDef* hi2c); //9 SCL clocks + STOP: releases a stuck SDA
+
+#define DS3231_TIME_US() HAL_Host_Micros()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STM32L4XX_HAL_H_ */
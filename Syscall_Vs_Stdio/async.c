@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <aio.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "time_sys_stdio.h"
+#include "uring.h"
+
+
+//user defines
+#define ASYNC_MAX_DEPTH 256
+#define ASYNC_MAX_WORKERS 16 //pread pool threads; deeper queues just wait in the submission queue
+
+
+struct async_run //what every engine fills in
+{
+    int fd;
+    off_t size;
+    size_t block;
+    int depth;
+    char *buffers; //depth * block
+    double *latency; //per request, submit to reap
+    long requests;
+    long bytes;
+};
+
+
+//POSIX AIO: depth aio_read()s in flight, refilled as aio_suspend() reports completions
+static int async_aio(struct async_run *r)
+{
+    struct aiocb cbs[ASYNC_MAX_DEPTH];
+    const struct aiocb *list[ASYNC_MAX_DEPTH] = {0}; //NULL slots are skipped by aio_suspend() and the scan below
+    double submitted[ASYNC_MAX_DEPTH];
+    off_t next = 0;
+    int inflight = 0;
+    int slots = 0; //fewer than depth when the file is shorter than depth blocks
+
+    memset(cbs, 0, sizeof(cbs));
+    for (; slots < r->depth && next < r->size; slots++, next += r->block)
+    {
+        int i = slots;
+        cbs[i].aio_fildes = r->fd;
+        cbs[i].aio_buf = r->buffers + i * r->block;
+        cbs[i].aio_nbytes = r->block;
+        cbs[i].aio_offset = next;
+        submitted[i] = timestamp();
+        if (aio_read(&cbs[i]) < 0)
+        {
+            perror("aio_read");
+            return -1;
+        }
+        list[i] = &cbs[i];
+        inflight++;
+    }
+
+    while (inflight > 0)
+    {
+        aio_suspend(list, slots, NULL);
+        for (int i = 0; i < slots; i++)
+        {
+            if (list[i] == NULL || aio_error(&cbs[i]) == EINPROGRESS)
+            {
+                continue;
+            }
+            ssize_t x = aio_return(&cbs[i]);
+            r->latency[r->requests++] = timestamp() - submitted[i];
+            r->bytes += x > 0 ? x : 0;
+            inflight--;
+            list[i] = NULL;
+
+            if (next < r->size)
+            {
+                cbs[i].aio_offset = next;
+                next += r->block;
+                submitted[i] = timestamp();
+                if (aio_read(&cbs[i]) < 0)
+                {
+                    perror("aio_read");
+                    return -1;
+                }
+                list[i] = &cbs[i];
+                inflight++;
+            }
+        }
+    }
+    return 0;
+}
+
+//lio_listio: whole batches of depth reads, submitted with one call and drained before the next batch
+static int async_lio(struct async_run *r)
+{
+    struct aiocb cbs[ASYNC_MAX_DEPTH];
+    struct aiocb *batch[ASYNC_MAX_DEPTH];
+
+    memset(cbs, 0, sizeof(cbs));
+    for (off_t next = 0; next < r->size;)
+    {
+        int n = 0;
+        for (; n < r->depth && next < r->size; n++, next += r->block)
+        {
+            cbs[n].aio_fildes = r->fd;
+            cbs[n].aio_buf = r->buffers + n * r->block;
+            cbs[n].aio_nbytes = r->block;
+            cbs[n].aio_offset = next;
+            cbs[n].aio_lio_opcode = LIO_READ;
+            batch[n] = &cbs[n];
+        }
+
+        double submitted = timestamp();
+        if (lio_listio(LIO_NOWAIT, batch, n, NULL) < 0)
+        {
+            perror("lio_listio");
+            return -1;
+        }
+        for (int left = n; left > 0;)
+        {
+            aio_suspend((const struct aiocb *const *)batch, n, NULL);
+            for (int i = 0; i < n; i++)
+            {
+                if (batch[i] == NULL || aio_error(batch[i]) == EINPROGRESS)
+                {
+                    continue;
+                }
+                ssize_t x = aio_return(batch[i]);
+                r->latency[r->requests++] = timestamp() - submitted;
+                r->bytes += x > 0 ? x : 0;
+                batch[i] = NULL;
+                left--;
+            }
+        }
+    }
+    return 0;
+}
+
+
+//pread thread pool: a submission ring and a completion ring, each behind a mutex and condition variable
+struct pool_request
+{
+    off_t offset;
+    int slot;
+    ssize_t result;
+    double submitted;
+};
+
+struct pool_queue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    struct pool_request items[ASYNC_MAX_DEPTH];
+    int head;
+    int count;
+};
+
+struct pool
+{
+    struct async_run *run;
+    struct pool_queue submit;
+    struct pool_queue complete;
+    int stop;
+};
+
+static void queue_init(struct pool_queue *q)
+{
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->ready, NULL);
+    q->head = 0;
+    q->count = 0;
+    return;
+}
+
+static void queue_destroy(struct pool_queue *q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->ready);
+    return;
+}
+
+static void queue_push(struct pool_queue *q, struct pool_request req) //never full: at most depth requests exist
+{
+    pthread_mutex_lock(&q->lock);
+    q->items[(q->head + q->count) % ASYNC_MAX_DEPTH] = req;
+    q->count++;
+    pthread_cond_signal(&q->ready);
+    pthread_mutex_unlock(&q->lock);
+    return;
+}
+
+static int queue_pop(struct pool_queue *q, struct pool_request *req, const int *stop) //0 once stopped and empty
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && (stop == NULL || !*stop))
+    {
+        pthread_cond_wait(&q->ready, &q->lock);
+    }
+    int found = q->count > 0;
+    if (found)
+    {
+        *req = q->items[q->head];
+        q->head = (q->head + 1) % ASYNC_MAX_DEPTH;
+        q->count--;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+static void *pool_worker(void *arg)
+{
+    struct pool *p = arg;
+    struct pool_request req;
+    while (queue_pop(&p->submit, &req, &p->stop))
+    {
+        req.result = pread(p->run->fd, p->run->buffers + req.slot * p->run->block, p->run->block, req.offset);
+        queue_push(&p->complete, req);
+    }
+    return NULL;
+}
+
+static void pool_stop(struct pool *p, pthread_t *workers, int threads) //ends and joins the workers started, frees the queues
+{
+    pthread_mutex_lock(&p->submit.lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->submit.ready);
+    pthread_mutex_unlock(&p->submit.lock);
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    queue_destroy(&p->submit);
+    queue_destroy(&p->complete);
+    return;
+}
+
+static int async_pool(struct async_run *r)
+{
+    struct pool p;
+    pthread_t workers[ASYNC_MAX_WORKERS];
+    int threads = r->depth < ASYNC_MAX_WORKERS ? r->depth : ASYNC_MAX_WORKERS;
+    off_t next = 0;
+    int inflight = 0;
+
+    p.run = r;
+    p.stop = 0;
+    queue_init(&p.submit);
+    queue_init(&p.complete);
+    for (int i = 0; i < threads; i++)
+    {
+        int err = pthread_create(&workers[i], NULL, pool_worker, &p);
+        if (err != 0) //a smaller pool would be reported under the wrong depth: give up on the run
+        {
+            fprintf(stderr, "Error Creating Pool Thread: %s\n", strerror(err));
+            pool_stop(&p, workers, i);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < r->depth && next < r->size; i++, next += r->block)
+    {
+        struct pool_request req = {next, i, 0, timestamp()};
+        queue_push(&p.submit, req);
+        inflight++;
+    }
+    while (inflight > 0)
+    {
+        struct pool_request req = {0}; //queue_pop() without a stop flag always fills it, which -O3 cannot prove
+        queue_pop(&p.complete, &req, NULL);
+        r->latency[r->requests++] = timestamp() - req.submitted;
+        r->bytes += req.result > 0 ? req.result : 0;
+        inflight--;
+        if (next < r->size)
+        {
+            struct pool_request again = {next, req.slot, 0, timestamp()};
+            next += r->block;
+            queue_push(&p.submit, again);
+            inflight++;
+        }
+    }
+
+    pool_stop(&p, workers, threads);
+    return 0;
+}
+
+//io_uring: the same refill loop on IORING_OP_READ, for reference where the kernel allows it
+static int async_uring(struct async_run *r)
+{
+    struct uring ring;
+    double submitted[ASYNC_MAX_DEPTH];
+    int free_slots[ASYNC_MAX_DEPTH];
+    int free_count = r->depth;
+    off_t next = 0;
+
+    if (uring_init(&ring, r->depth) < 0)
+    {
+        perror("io_uring unavailable");
+        return -1;
+    }
+    for (int i = 0; i < r->depth; i++)
+    {
+        free_slots[i] = i;
+    }
+
+    while (next < r->size || free_count < r->depth)
+    {
+        while (free_count > 0 && next < r->size)
+        {
+            struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+            if (sqe == NULL)
+            {
+                break;
+            }
+            int slot = free_slots[--free_count];
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = r->fd;
+            sqe->addr = (unsigned long)(r->buffers + slot * r->block);
+            sqe->len = r->block;
+            sqe->off = next;
+            sqe->user_data = slot; //buffer slot comes back with the completion
+            submitted[slot] = timestamp();
+            next += r->block;
+        }
+        if (uring_submit(&ring, 1) < 0)
+        {
+            perror("io_uring_enter");
+            uring_exit(&ring);
+            return -1;
+        }
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&ring)) != NULL)
+        {
+            int slot = cqe->user_data;
+            r->latency[r->requests++] = timestamp() - submitted[slot];
+            r->bytes += cqe->res > 0 ? cqe->res : 0;
+            free_slots[free_count++] = slot;
+            uring_cqe_seen(&ring);
+        }
+    }
+    uring_exit(&ring);
+    return 0;
+}
+
+//synchronous pread loop at the same block size, the bar the async engines have to clear
+static int async_sync(struct async_run *r)
+{
+    for (off_t off = 0; off < r->size; off += r->block)
+    {
+        double start = timestamp();
+        ssize_t x = pread(r->fd, r->buffers, r->block, off);
+        r->latency[r->requests++] = timestamp() - start;
+        if (x <= 0)
+        {
+            break;
+        }
+        r->bytes += x;
+    }
+    return 0;
+}
+
+
+static void run_async(const char *name, int (*fn)(struct async_run *), int runs, int depth, size_t block, off_t size)
+{
+    long per_run = (size + block - 1) / block;
+    struct async_run r;
+    r.size = size;
+    r.block = block;
+    r.depth = depth;
+    r.buffers = malloc(depth * block);
+    r.latency = malloc(per_run * sizeof(double));
+    if (r.buffers == NULL || r.latency == NULL)
+    {
+        perror("Error Allocating Buffers");
+        free(r.buffers);
+        free(r.latency);
+        return;
+    }
+
+    double total = 0;
+    double p50 = 0;
+    double p99 = 0;
+    int ok = 1;
+    for (int i = 0; i < runs && ok; i++)
+    {
+        r.fd = open(file_name, O_RDONLY);
+        if (r.fd < 0)
+        {
+            perror("Error Opening File");
+            break;
+        }
+        r.requests = 0;
+        r.bytes = 0;
+        double start = timestamp();
+        ok = fn(&r) == 0 && r.bytes == size;
+        total += timestamp() - start;
+        close(r.fd);
+
+        sort_samples(r.latency, r.requests);
+        p50 += percentile(r.latency, r.requests, 50);
+        p99 += percentile(r.latency, r.requests, 99);
+    }
+
+    if (ok)
+    {
+        printf("%-14s depth %3d: %9.1f MB/s  completion p50 %8.1f us  p99 %8.1f us\n", name, depth,
+               size / (1024.0 * 1024.0) * runs / total, p50 / runs * 1e6, p99 / runs * 1e6);
+    }
+    else
+    {
+        printf("%-14s depth %3d: failed\n", name, depth);
+    }
+    free(r.buffers);
+    free(r.latency);
+    return;
+}
+
+void async_reads(int runs, int depth, size_t block) //depth 0 sweeps 1, 4, 16, 64
+{
+    struct stat st;
+    if (stat(file_name, &st) < 0)
+    {
+        perror("Error Opening File");
+        return;
+    }
+    if (depth > ASYNC_MAX_DEPTH)
+    {
+        depth = ASYNC_MAX_DEPTH;
+    }
+
+    double baseline = 0;
+    for (int i = 0; i < runs; i++)
+    {
+        baseline += engine('h');
+    }
+    printf("Async reads of %s in %zu Byte blocks (%d runs each)\n", file_name, block, runs);
+    printf("file_per_chunk_syscall() baseline: %9.1f MB/s\n", st.st_size / (1024.0 * 1024.0) * runs / baseline);
+
+    run_async("sync pread", async_sync, runs, 1, block, st.st_size);
+
+    const int sweep[] = {1, 4, 16, 64};
+    for (int d = 0; d < 4; d++)
+    {
+        int qd = depth > 0 ? depth : sweep[d];
+        printf("//////////////////////////////////////\n");
+        run_async("aio_read", async_aio, runs, qd, block, st.st_size);
+        run_async("lio_listio", async_lio, runs, qd, block, st.st_size);
+        run_async("pread pool", async_pool, runs, qd, block, st.st_size);
+        run_async("io_uring", async_uring, runs, qd, block, st.st_size);
+        if (depth > 0)
+        {
+            break;
+        }
+    }
+    printf("//////////////////////////////////////\n");
+    return;
+}
@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "time_sys_stdio.h"
+#include "autotune.h"
+#include "uring.h"
+
+
+//user defines
+#define AUTOTUNE_PROBE_BYTES (16LL * 1024 * 1024) //each probe reads at most this much of the file
+#define AUTOTUNE_REPEATS 2 //best of, per probe
+#define AUTOTUNE_MAX_CHUNK (1024 * 1024)
+#define AUTOTUNE_MAX_DEPTH 64
+#define AUTOTUNE_MARGIN 1.05 //a deeper queue has to beat the shallower one by 5% to be picked
+
+
+static const size_t autotune_chunks[] = {4096, 65536, 1048576};
+static const int autotune_depths[] = {1, 4, 16, 64};
+static const char autotune_engines[] = "hdi";
+
+
+//every probe starts cold, so the numbers describe the device rather than the page cache
+static void drop_cache(int fd, off_t limit)
+{
+    posix_fadvise(fd, 0, limit, POSIX_FADV_DONTNEED);
+    return;
+}
+
+static double autotune_clock() //own monotonic clock, so the library doesn't need time_sys_stdio.o
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static double rate(off_t bytes, double seconds)
+{
+    return seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0;
+}
+
+static double probe_read(const char *path, char *buf, size_t chunk, off_t limit) //the read() loop of file_per_chunk_syscall()
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    drop_cache(fd, limit);
+    off_t done = 0;
+    ssize_t x;
+    double start = autotune_clock();
+    while (done < limit && (x = read(fd, buf, chunk)) > 0)
+    {
+        done += x;
+    }
+    double t = autotune_clock() - start;
+    close(fd);
+    return rate(done, t);
+}
+
+static double probe_stdio(const char *path, char *buf, size_t chunk, off_t limit) //the fread() loop of file_per_chunk_stdio(), buffered at chunk
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    drop_cache(fileno(file), limit);
+    setvbuf(file, NULL, _IOFBF, chunk);
+    off_t done = 0;
+    size_t x;
+    double start = autotune_clock();
+    while (done < limit && (x = fread(buf, 1, chunk, file)) > 0)
+    {
+        done += x;
+    }
+    double t = autotune_clock() - start;
+    fclose(file);
+    return rate(done, t);
+}
+
+static double probe_mmap(const char *path, char *buf, size_t chunk, off_t limit) //the copy-out loop of file_mmap()
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    drop_cache(fd, limit);
+    double start = autotune_clock();
+    char *map = mmap(NULL, limit, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+    madvise(map, limit, MADV_SEQUENTIAL);
+    for (off_t off = 0; off < limit; off += chunk)
+    {
+        size_t len = (limit - off < (off_t)chunk) ? (size_t)(limit - off) : chunk;
+        memcpy(buf, map + off, len);
+        __asm__ __volatile__("" : : "r"(buf) : "memory"); //keep the copy from being optimised away
+    }
+    munmap(map, limit);
+    double t = autotune_clock() - start;
+    close(fd);
+    return rate(limit, t);
+}
+
+static double probe_depth(const char *path, char *buffers, size_t chunk, int depth, off_t limit) //depth reads of chunk in flight on io_uring
+{
+    struct uring ring;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (uring_init(&ring, depth) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    drop_cache(fd, limit);
+
+    int free_slots[AUTOTUNE_MAX_DEPTH];
+    int free_count = depth;
+    for (int i = 0; i < depth; i++)
+    {
+        free_slots[i] = i;
+    }
+    off_t next = 0;
+    off_t done = 0;
+    int failed = 0;
+    double start = autotune_clock();
+    while (!failed && (next < limit || free_count < depth))
+    {
+        while (free_count > 0 && next < limit)
+        {
+            struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+            if (sqe == NULL)
+            {
+                break;
+            }
+            int slot = free_slots[--free_count];
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = (unsigned long)(buffers + slot * chunk);
+            sqe->len = chunk;
+            sqe->off = next;
+            sqe->user_data = slot;
+            next += chunk;
+        }
+        if (uring_submit(&ring, 1) < 0)
+        {
+            failed = 1;
+            break;
+        }
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&ring)) != NULL)
+        {
+            failed |= cqe->res < 0;
+            done += cqe->res > 0 ? cqe->res : 0;
+            free_slots[free_count++] = cqe->user_data;
+            uring_cqe_seen(&ring);
+        }
+    }
+    double t = autotune_clock() - start;
+    uring_exit(&ring);
+    close(fd);
+    return failed ? -1 : rate(done, t);
+}
+
+static double best_of(double (*probe)(const char *, char *, size_t, off_t), const char *path, char *buf, size_t chunk, off_t limit)
+{
+    double best = -1;
+    for (int i = 0; i < AUTOTUNE_REPEATS; i++)
+    {
+        double r = probe(path, buf, chunk, limit);
+        best = r > best ? r : best;
+    }
+    return best;
+}
+
+
+//config file: one line per device, "major:minor engine chunk depth MB/s"
+static int config_load(const char *config, dev_t dev, struct io_tuning *tuning)
+{
+    FILE *file = fopen(config, "r");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    char line[256];
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), file) != NULL)
+    {
+        unsigned maj, min;
+        struct io_tuning t;
+        if (sscanf(line, "%u:%u %c %zu %d %lf", &maj, &min, &t.engine, &t.chunk, &t.depth, &t.mbps) == 6 &&
+            maj == major(dev) && min == minor(dev) && strchr(autotune_engines, t.engine) != NULL &&
+            t.chunk > 0 && t.depth > 0)
+        {
+            *tuning = t;
+            found = 1;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+static int config_save(const char *config, dev_t dev, const struct io_tuning *tuning) //rewrites the file with this device's line replaced
+{
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", config);
+    FILE *out = fopen(tmp, "w");
+    if (out == NULL)
+    {
+        perror("Error Writing Autotune Config");
+        return -1;
+    }
+    fprintf(out, "# device engine chunk depth MB/s, written by io_autotune()\n");
+
+    FILE *in = fopen(config, "r");
+    if (in != NULL)
+    {
+        char line[256];
+        while (fgets(line, sizeof(line), in) != NULL)
+        {
+            unsigned maj, min;
+            if (line[0] == '#' || (sscanf(line, "%u:%u", &maj, &min) == 2 && maj == major(dev) && min == minor(dev)))
+            {
+                continue;
+            }
+            fputs(line, out);
+        }
+        fclose(in);
+    }
+    fprintf(out, "%u:%u %c %zu %d %.1f\n", major(dev), minor(dev), tuning->engine, tuning->chunk, tuning->depth, tuning->mbps);
+
+    if (fclose(out) != 0 || rename(tmp, config) < 0)
+    {
+        perror("Error Writing Autotune Config");
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+
+int io_autotune(const char *path, const char *config, int force, struct io_tuning *tuning)
+{
+    struct stat st;
+    if (stat(path, &st) < 0)
+    {
+        perror("Error Opening File");
+        return -1;
+    }
+    if (config == NULL)
+    {
+        config = AUTOTUNE_CONFIG;
+    }
+    if (!force && config_load(config, st.st_dev, tuning))
+    {
+        return 1;
+    }
+    if (st.st_size == 0)
+    {
+        fprintf(stderr, "Cannot calibrate on an empty file\n");
+        return -1;
+    }
+
+    off_t limit = st.st_size < AUTOTUNE_PROBE_BYTES ? st.st_size : AUTOTUNE_PROBE_BYTES;
+    char *buf = malloc((size_t)AUTOTUNE_MAX_DEPTH * AUTOTUNE_MAX_CHUNK);
+    if (buf == NULL)
+    {
+        perror("Error Allocating Buffers");
+        return -1;
+    }
+
+    //engine x chunk grid, each probe cold and best of AUTOTUNE_REPEATS
+    tuning->engine = 'h';
+    tuning->chunk = CHUNK_SIZE;
+    tuning->depth = 1;
+    tuning->mbps = -1;
+    for (const char *e = autotune_engines; *e != '\0'; e++)
+    {
+        double (*probe)(const char *, char *, size_t, off_t) = *e == 'h' ? probe_read : *e == 'd' ? probe_stdio : probe_mmap;
+        for (size_t c = 0; c < sizeof(autotune_chunks) / sizeof(autotune_chunks[0]); c++)
+        {
+            double r = best_of(probe, path, buf, autotune_chunks[c], limit);
+            if (r > tuning->mbps)
+            {
+                tuning->engine = *e;
+                tuning->chunk = autotune_chunks[c];
+                tuning->mbps = r;
+            }
+        }
+    }
+    if (tuning->mbps < 0)
+    {
+        fprintf(stderr, "Every calibration probe failed\n");
+        free(buf);
+        return -1;
+    }
+
+    //queue depth at the chosen chunk, only for read(); fread() and mmap have no queue to deepen
+    //a deeper queue is only kept if keeping more reads in flight clearly pays off
+    double shallow = -1;
+    for (size_t d = 0; tuning->engine == 'h' && d < sizeof(autotune_depths) / sizeof(autotune_depths[0]); d++)
+    {
+        double r = -1;
+        for (int i = 0; i < AUTOTUNE_REPEATS; i++)
+        {
+            double x = probe_depth(path, buf, tuning->chunk, autotune_depths[d], limit);
+            r = x > r ? x : r;
+        }
+        if (r < 0) //no io_uring here: stay synchronous
+        {
+            break;
+        }
+        if (shallow < 0 || r > shallow * AUTOTUNE_MARGIN)
+        {
+            shallow = r;
+            tuning->depth = autotune_depths[d];
+        }
+    }
+    free(buf);
+
+    return config_save(config, st.st_dev, tuning);
+}
+
+
+void autotune(const char *path, int force) //command line front end for io_autotune()
+{
+    struct io_tuning t;
+    int cached = io_autotune(path, NULL, force, &t);
+    if (cached < 0)
+    {
+        return;
+    }
+    const char *name = t.engine == 'h' ? "read()" : t.engine == 'd' ? "fread()" : "mmap";
+    printf("Autotune for %s (%s %s): engine %s, chunk %zu Bytes, queue depth %d, %.1f MB/s\n",
+           path, cached ? "cached in" : "probed, saved to", AUTOTUNE_CONFIG, name, t.chunk, t.depth, t.mbps);
+    return;
+}
@@ -0,0 +1,24 @@
+#ifndef AUTOTUNE_H_
+#define AUTOTUNE_H_
+
+#include <stddef.h>
+
+
+//I/O autotuner: calibrates the read path for the device a file lives on, so callers don't hard-code CHUNK_SIZE.
+//Results are cached per device (st_dev) in a small text file; later calls for the same device just read it back.
+#define AUTOTUNE_CONFIG "autotune.conf" //default cache, relative to the working directory
+
+struct io_tuning
+{
+    char engine; //'h' read() loop, 'd' fread() loop, 'i' mmap; same letters as engine()
+    size_t chunk; //bytes per call (also the stdio buffer size for 'd')
+    int depth; //reads worth keeping in flight (io_uring probe); 1 means plain synchronous reads
+    double mbps; //measured throughput of the chosen engine and chunk
+};
+
+//Fills tuning for the device holding path. config may be NULL for AUTOTUNE_CONFIG; force re-probes even if cached.
+//Returns 1 when the result came from the cache, 0 after probing, -1 on error.
+//A probe whose result could not be written to config still fills tuning but returns -1.
+int io_autotune(const char *path, const char *config, int force, struct io_tuning *tuning);
+
+#endif /* AUTOTUNE_H_ */
@@ -0,0 +1,164 @@
+#define _GNU_SOURCE //memfd_create
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "time_sys_stdio.h"
+
+
+//user defines
+#define ROOFLINE_SIZE (64 * 1024 * 1024)
+#define ROOFLINE_RUNS 5
+#define TMPFS_COPY "/dev/shm/time_sys_stdio_file.txt"
+
+
+static double memcpy_roofline() //best-of memcpy bandwidth in MB/s (bytes delivered to the destination)
+{
+    char *src = malloc(ROOFLINE_SIZE);
+    char *dst = malloc(ROOFLINE_SIZE);
+    double best = 0;
+    if (src == NULL || dst == NULL)
+    {
+        free(src);
+        free(dst);
+        return -1;
+    }
+    memset(src, 1, ROOFLINE_SIZE);
+    memset(dst, 0, ROOFLINE_SIZE); //fault the pages in outside the timed part
+
+    for (int i = 0; i < ROOFLINE_RUNS; i++)
+    {
+        double start = timestamp();
+        memcpy(dst, src, ROOFLINE_SIZE);
+        double t = timestamp() - start;
+        double rate = ROOFLINE_SIZE / (1024.0 * 1024.0) / t;
+        if (rate > best)
+        {
+            best = rate;
+        }
+    }
+
+    free(src);
+    free(dst);
+    return best;
+}
+
+static int copy_into(int out, const char *path) //copies path into an already open descriptor
+{
+    char a[64 * 1024];
+    int in = open(path, O_RDONLY);
+    ssize_t x;
+    if (in < 0)
+    {
+        perror("Error Opening File");
+        return -1;
+    }
+    while ((x = read(in, a, sizeof(a))) > 0)
+    {
+        if (write(out, a, x) != x)
+        {
+            perror("Error Copying File");
+            close(in);
+            return -1;
+        }
+    }
+    close(in);
+    return x < 0 ? -1 : 0;
+}
+
+
+void baselines(int runs, const char *engines) //engines against disk, tmpfs and memfd copies, next to the memcpy roofline
+{
+    const char *original = file_name; //the engines are pointed at each copy in turn, then back at this
+    struct stat st;
+    char memfd_path[64];
+    char disk_name[256];
+    if (stat(original, &st) < 0)
+    {
+        perror("Error Opening File");
+        return;
+    }
+    double megabytes = st.st_size / (1024.0 * 1024.0);
+
+    //tmpfs copy
+    int tmp = open(TMPFS_COPY, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (tmp < 0 || copy_into(tmp, original) < 0)
+    {
+        perror("Error Creating tmpfs Copy");
+        if (tmp >= 0)
+        {
+            close(tmp);
+            unlink(TMPFS_COPY);
+        }
+        return;
+    }
+    close(tmp);
+
+    //memfd copy, reopened by the engines through /proc so they keep using plain open()/fopen()
+    int mfd = memfd_create("time_sys_stdio_copy", 0);
+    if (mfd < 0 || copy_into(mfd, original) < 0)
+    {
+        perror("Error Creating memfd Copy");
+        if (mfd >= 0)
+        {
+            close(mfd);
+        }
+        unlink(TMPFS_COPY);
+        return;
+    }
+    snprintf(memfd_path, sizeof(memfd_path), "/proc/self/fd/%d", mfd);
+
+    double roofline = memcpy_roofline();
+    printf("memcpy roofline: %.1f MB/s (best of %d x %d MB)\n", roofline, ROOFLINE_RUNS, ROOFLINE_SIZE / (1024 * 1024));
+
+    snprintf(disk_name, sizeof(disk_name), "disk (%s)", original);
+    const char *backings[] = {original, TMPFS_COPY, memfd_path};
+    const char *names[] = {disk_name, "tmpfs (/dev/shm)", "memfd"};
+    for (int b = 0; b < 3; b++)
+    {
+        file_name = backings[b];
+        printf("//////////////////////////////////////\n");
+        printf("-:- %s, %d runs each\n", names[b], runs);
+        printf("//////////////////////////////////////\n");
+        for (const char *e = engines; *e != '\0'; e++)
+        {
+            double total = 0;
+            int i;
+            for (i = 0; i < runs; i++)
+            {
+                double t = engine(*e);
+                if (t < 0)
+                {
+                    break;
+                }
+                total += t;
+            }
+            if (i < runs)
+            {
+                printf("engine %c: failed\n", *e);
+                continue;
+            }
+
+            double t = total / runs;
+            if (engine_single(*e)) //single call latency, no bandwidth to speak of
+            {
+                printf("engine %c: %f seconds\n", *e, t);
+            }
+            else
+            {
+                double rate = megabytes / t;
+                printf("engine %c: %f seconds  %9.1f MB/s  %5.1f%% of memcpy\n", *e, t, rate, 100.0 * rate / roofline);
+            }
+        }
+    }
+    printf("//////////////////////////////////////\n");
+
+    file_name = original;
+    close(mfd);
+    unlink(TMPFS_COPY);
+    return;
+}
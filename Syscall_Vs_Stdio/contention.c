@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "time_sys_stdio.h"
+
+
+//user defines
+#define CONTENTION_MAX_READERS 64
+
+
+struct reader //one thread's (or process') share of the file and what it measured
+{
+    int id;
+    int readers;
+    FILE *file; //shared stream ('s')
+    int fd; //shared descriptor ('p')
+    off_t size;
+    char mode;
+    long bytes;
+    double seconds;
+    double lock_wait;
+};
+
+
+static void *contention_thread(void *arg) //reads this reader's share of file_name in CHUNK_SIZE pieces
+{
+    struct reader *r = arg;
+    char a[CHUNK_SIZE];
+    double start = timestamp();
+
+    if (r->mode == 's') //shared FILE*: everybody pulls from one stream position behind stdio's lock
+    {
+        for (;;)
+        {
+            double before = timestamp();
+            flockfile(r->file); //taken explicitly so the wait can be measured; fread's own lock is then uncontended
+            r->lock_wait += timestamp() - before;
+            size_t x = fread(a, sizeof(char), CHUNK_SIZE, r->file);
+            funlockfile(r->file);
+            if (x == 0)
+            {
+                break;
+            }
+            r->bytes += x;
+        }
+    }
+    else if (r->mode == 'p') //shared fd: interleaved chunks with pread, no shared file position
+    {
+        for (off_t off = (off_t)r->id * CHUNK_SIZE; off < r->size; off += (off_t)r->readers * CHUNK_SIZE)
+        {
+            ssize_t x = pread(r->fd, a, sizeof(a), off);
+            if (x <= 0)
+            {
+                break;
+            }
+            r->bytes += x;
+        }
+    }
+    else //own fd: a contiguous slice through a private open file description
+    {
+        int fd = open(file_name, O_RDONLY);
+        if (fd < 0)
+        {
+            perror("Error Opening File");
+            return NULL;
+        }
+        off_t begin = r->size / r->readers * r->id;
+        off_t end = (r->id == r->readers - 1) ? r->size : r->size / r->readers * (r->id + 1);
+        lseek(fd, begin, SEEK_SET);
+        while (begin < end)
+        {
+            size_t want = (end - begin < CHUNK_SIZE) ? (size_t)(end - begin) : CHUNK_SIZE;
+            ssize_t x = read(fd, a, want);
+            if (x <= 0)
+            {
+                break;
+            }
+            begin += x;
+            r->bytes += x;
+        }
+        close(fd);
+    }
+
+    r->seconds = timestamp() - start;
+    return NULL;
+}
+
+static int run_readers(char mode, int readers, struct reader *r, off_t size) //threads for 's','p','o', forked processes for 'f'
+{
+    FILE *file = NULL;
+    int fd = -1;
+    if (mode == 's')
+    {
+        file = fopen(file_name, "r");
+        if (file == NULL)
+        {
+            perror("Error Opening File");
+            return -1;
+        }
+    }
+    else if (mode == 'p')
+    {
+        fd = open(file_name, O_RDONLY);
+        if (fd < 0)
+        {
+            perror("Error Opening File");
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < readers; i++)
+    {
+        memset(&r[i], 0, sizeof(r[i]));
+        r[i].id = i;
+        r[i].readers = readers;
+        r[i].file = file;
+        r[i].fd = fd;
+        r[i].size = size;
+        r[i].mode = (mode == 'f') ? 'o' : mode;
+    }
+
+    if (mode == 'f') //processes: the children report their struct back through a pipe
+    {
+        int pipes[2];
+        if (pipe(pipes) < 0)
+        {
+            perror("Error Creating Pipe");
+            return -1;
+        }
+        for (int i = 0; i < readers; i++)
+        {
+            pid_t pid = fork();
+            if (pid < 0) //fewer workers than reported: reap the ones started and give up on the run
+            {
+                perror("Error Forking Reader");
+                close(pipes[0]);
+                close(pipes[1]);
+                while (wait(NULL) > 0)
+                {
+                }
+                return -1;
+            }
+            if (pid == 0)
+            {
+                close(pipes[0]);
+                contention_thread(&r[i]);
+                if (write(pipes[1], &r[i], sizeof(r[i])) != sizeof(r[i]))
+                {
+                    _exit(1);
+                }
+                _exit(0);
+            }
+        }
+        close(pipes[1]);
+        struct reader done;
+        while (read(pipes[0], &done, sizeof(done)) == sizeof(done))
+        {
+            r[done.id] = done;
+        }
+        close(pipes[0]);
+        while (wait(NULL) > 0)
+        {
+        }
+        return 0;
+    }
+
+    pthread_t tids[CONTENTION_MAX_READERS];
+    int started = 0;
+    int status = 0;
+    for (; started < readers; started++)
+    {
+        int err = pthread_create(&tids[started], NULL, contention_thread, &r[started]);
+        if (err != 0) //fewer readers than reported: let the started ones finish, then fail the run
+        {
+            fprintf(stderr, "Error Creating Reader Thread: %s\n", strerror(err));
+            status = -1;
+            break;
+        }
+    }
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    return status;
+}
+
+
+void contention(int runs, int readers) //N concurrent readers of file_name, four ways
+{
+    struct reader r[CONTENTION_MAX_READERS];
+    struct stat st;
+    if (readers > CONTENTION_MAX_READERS)
+    {
+        readers = CONTENTION_MAX_READERS;
+    }
+    if (stat(file_name, &st) < 0)
+    {
+        perror("Error Opening File");
+        return;
+    }
+
+    const char modes[] = {'s', 'p', 'o', 'f'};
+    const char *names[] = {"shared FILE* (fread)", "shared fd (pread)", "per-thread fd (read)", "forked processes (read)"};
+
+    printf("%d concurrent readers of %s in %d Byte chunks (%d runs each)\n", readers, file_name, CHUNK_SIZE, runs);
+    for (int m = 0; m < 4; m++)
+    {
+        double mb[CONTENTION_MAX_READERS] = {0};
+        double wait_time[CONTENTION_MAX_READERS] = {0};
+        double wall = 0;
+
+        for (int run = 0; run < runs; run++)
+        {
+            double start = timestamp();
+            if (run_readers(modes[m], readers, r, st.st_size) < 0)
+            {
+                return;
+            }
+            wall += timestamp() - start;
+            for (int i = 0; i < readers; i++)
+            {
+                mb[i] += r[i].seconds > 0 ? r[i].bytes / (1024.0 * 1024.0) / r[i].seconds : 0;
+                wait_time[i] += r[i].lock_wait;
+            }
+        }
+
+        printf("//////////////////////////////////////\n");
+        printf("-:- %s\n", names[m]);
+        printf("//////////////////////////////////////\n");
+        for (int i = 0; i < readers; i++)
+        {
+            printf("reader %2d: %9.1f MB/s", i, mb[i] / runs);
+            if (modes[m] == 's')
+            {
+                printf("  lock wait %f seconds", wait_time[i] / runs);
+            }
+            printf("\n");
+        }
+        printf("aggregate: %9.1f MB/s\n", st.st_size / (1024.0 * 1024.0) * runs / wall);
+    }
+    printf("//////////////////////////////////////\n");
+    return;
+}
@@ -0,0 +1,261 @@
+#define _GNU_SOURCE //copy_file_range
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/resource.h>
+#include <linux/fs.h> //FICLONE
+
+#include "time_sys_stdio.h"
+
+
+//user defines
+#define COPY_NAME "file.txt.copy"
+#define COPY_MAX_CHUNK (1024 * 1024)
+#define COPY_STEP (1024 * 1024 * 1024) //largest single sendfile/copy_file_range/write request
+
+
+struct copy_job
+{
+    int in;
+    int out;
+    FILE *fin;
+    FILE *fout;
+    off_t size;
+    size_t chunk;
+    char *buf;
+};
+
+
+static int copy_rw(struct copy_job *j) //read()/write() loop at j->chunk
+{
+    ssize_t x;
+    while ((x = read(j->in, j->buf, j->chunk)) > 0)
+    {
+        for (ssize_t done = 0; done < x;)
+        {
+            ssize_t y = write(j->out, j->buf + done, x - done);
+            if (y <= 0)
+            {
+                return -1;
+            }
+            done += y;
+        }
+    }
+    return x < 0 ? -1 : 0;
+}
+
+static int copy_stdio(struct copy_job *j) //fread()/fwrite() at j->chunk on default stdio buffers
+{
+    size_t x;
+    while ((x = fread(j->buf, 1, j->chunk, j->fin)) > 0)
+    {
+        if (fwrite(j->buf, 1, x, j->fout) != x)
+        {
+            return -1;
+        }
+    }
+    return (ferror(j->fin) || fflush(j->fout) != 0) ? -1 : 0;
+}
+
+static int copy_mmap_write(struct copy_job *j) //source mapped, handed to write() straight from the mapping
+{
+    char *map = mmap(NULL, j->size, PROT_READ, MAP_PRIVATE, j->in, 0);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+    madvise(map, j->size, MADV_SEQUENTIAL);
+    for (off_t done = 0; done < j->size;)
+    {
+        size_t len = (j->size - done < COPY_STEP) ? (size_t)(j->size - done) : COPY_STEP;
+        ssize_t y = write(j->out, map + done, len);
+        if (y <= 0)
+        {
+            munmap(map, j->size);
+            return -1;
+        }
+        done += y;
+    }
+    munmap(map, j->size);
+    return 0;
+}
+
+static int copy_mmap_both(struct copy_job *j) //both files mapped, one memcpy between them
+{
+    if (ftruncate(j->out, j->size) < 0)
+    {
+        return -1;
+    }
+    char *src = mmap(NULL, j->size, PROT_READ, MAP_PRIVATE, j->in, 0);
+    if (src == MAP_FAILED)
+    {
+        return -1;
+    }
+    char *dst = mmap(NULL, j->size, PROT_READ | PROT_WRITE, MAP_SHARED, j->out, 0);
+    if (dst == MAP_FAILED)
+    {
+        munmap(src, j->size);
+        return -1;
+    }
+    madvise(src, j->size, MADV_SEQUENTIAL);
+    madvise(dst, j->size, MADV_SEQUENTIAL);
+    memcpy(dst, src, j->size);
+    munmap(dst, j->size);
+    munmap(src, j->size);
+    return 0;
+}
+
+static int copy_sendfile(struct copy_job *j)
+{
+    for (off_t done = 0; done < j->size;)
+    {
+        ssize_t y = sendfile(j->out, j->in, NULL, COPY_STEP);
+        if (y <= 0)
+        {
+            return -1;
+        }
+        done += y;
+    }
+    return 0;
+}
+
+static int copy_range(struct copy_job *j) //copy_file_range: the filesystem may share extents or copy in the kernel
+{
+    for (off_t done = 0; done < j->size;)
+    {
+        ssize_t y = copy_file_range(j->in, NULL, j->out, NULL, COPY_STEP, 0);
+        if (y <= 0)
+        {
+            return -1;
+        }
+        done += y;
+    }
+    return 0;
+}
+
+static int copy_clone(struct copy_job *j) //reflink; only on filesystems with shared extents (btrfs, xfs, bcachefs)
+{
+    return ioctl(j->out, FICLONE, j->in);
+}
+
+
+static double cpu_seconds()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0;
+}
+
+static void run_copy(const char *name, int (*fn)(struct copy_job *), int runs, size_t chunk, off_t size, char *buf)
+{
+    double wall = 0;
+    double cpu = 0;
+    for (int i = 0; i < runs; i++)
+    {
+        struct copy_job j;
+        j.size = size;
+        j.chunk = chunk;
+        j.buf = buf;
+        j.in = open(file_name, O_RDONLY);
+        j.out = open(COPY_NAME, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (j.in < 0 || j.out < 0)
+        {
+            perror("Error Opening File");
+            if (j.in >= 0)
+            {
+                close(j.in);
+            }
+            if (j.out >= 0)
+            {
+                close(j.out);
+            }
+            return;
+        }
+        j.fin = fdopen(j.in, "r");
+        j.fout = fdopen(j.out, "w");
+        if (j.fin == NULL || j.fout == NULL)
+        {
+            perror("Error Opening File");
+            if (j.fin != NULL)
+            {
+                fclose(j.fin);
+            }
+            else
+            {
+                close(j.in);
+            }
+            if (j.fout != NULL)
+            {
+                fclose(j.fout);
+            }
+            else
+            {
+                close(j.out);
+            }
+            return;
+        }
+
+        double cpu_start = cpu_seconds();
+        double start = timestamp();
+        errno = 0;
+        int rc = fn(&j);
+        wall += timestamp() - start;
+        cpu += cpu_seconds() - cpu_start;
+        int saved = errno;
+
+        struct stat st;
+        int ok = rc == 0 && fstat(j.out, &st) == 0 && st.st_size == size;
+        fclose(j.fin);
+        fclose(j.fout);
+        unlink(COPY_NAME); //dirty pages of the copy go with it, so runs don't pile up writeback
+        if (!ok)
+        {
+            printf("%-24s: %s\n", name, (saved == EOPNOTSUPP || saved == EXDEV || saved == EINVAL || saved == ENOTTY) ?
+                   "not supported here" : "failed");
+            return;
+        }
+    }
+    printf("%-24s: %8.2f GB/s  CPU %7.3f s per copy (%3.0f%% of wall)\n", name,
+           size / (1024.0 * 1024.0 * 1024.0) * runs / wall, cpu / runs, 100.0 * cpu / wall);
+    return;
+}
+
+void copies(int runs) //copies file_name to COPY_NAME with every primitive; page-cache copies, no fsync
+{
+    struct stat st;
+    if (stat(file_name, &st) < 0 || st.st_size == 0)
+    {
+        perror("Error Opening File");
+        return;
+    }
+    char *buf = malloc(COPY_MAX_CHUNK);
+    if (buf == NULL)
+    {
+        perror("Error Allocating Buffers");
+        return;
+    }
+    memset(buf, 0, COPY_MAX_CHUNK);
+
+    printf("Copying %s (%lld Bytes) to %s, %d runs each\n", file_name, (long long)st.st_size, COPY_NAME, runs);
+    printf("//////////////////////////////////////\n");
+    run_copy("read/write 4K", copy_rw, runs, 4096, st.st_size, buf);
+    run_copy("read/write 64K", copy_rw, runs, 65536, st.st_size, buf);
+    run_copy("read/write 1M", copy_rw, runs, COPY_MAX_CHUNK, st.st_size, buf);
+    run_copy("fread/fwrite", copy_stdio, runs, CHUNK_SIZE, st.st_size, buf);
+    run_copy("mmap source + write", copy_mmap_write, runs, 0, st.st_size, buf);
+    run_copy("mmap both + memcpy", copy_mmap_both, runs, 0, st.st_size, buf);
+    run_copy("sendfile", copy_sendfile, runs, 0, st.st_size, buf);
+    run_copy("copy_file_range", copy_range, runs, 0, st.st_size, buf);
+    run_copy("FICLONE", copy_clone, runs, 0, st.st_size, buf);
+    printf("//////////////////////////////////////\n");
+
+    free(buf);
+    return;
+}
@@ -0,0 +1,485 @@
+#define _GNU_SOURCE //pthread_setaffinity_np
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+#include "time_sys_stdio.h"
+
+
+//user defines
+#define SCAN_DIR "scandata"
+#define SCAN_BUFFER (128 * 1024) //per-thread read buffer, reused for every task
+#define SCAN_SPLIT (4 * 1024 * 1024) //files above this are cut into chunks others can steal
+#define SCAN_MAX_THREADS 64
+#define SCAN_MAX_FILES 1024
+
+
+struct scan_task //one file, or a byte range of one file
+{
+    int file;
+    off_t offset;
+    off_t length;
+    int whole; //1 if the range has not been split yet
+};
+
+struct deque //per-thread deque: owner pushes/pops at the bottom, thieves take from the top
+{
+    pthread_mutex_t lock;
+    struct scan_task *tasks;
+    int capacity;
+    int top;
+    int bottom;
+};
+
+struct scan_pool
+{
+    int threads;
+    int files;
+    int fds[SCAN_MAX_FILES];
+    off_t sizes[SCAN_MAX_FILES];
+    struct deque deques[SCAN_MAX_THREADS];
+    long pending; //tasks queued or running; workers stop once it reaches 0
+    long steals;
+    uint64_t checksum; //sum of every 8 byte word scanned: the same for any thread count, so it checks the scan
+    pthread_mutex_t idle_lock; //idle workers sleep on idle_cond instead of spinning on the deques
+    pthread_cond_t idle_cond;
+    long posted; //bumped whenever tasks are pushed after the start, and when pending reaches 0
+};
+
+struct scan_worker
+{
+    struct scan_pool *pool;
+    int id;
+    char *buffer; //SCAN_BUFFER bytes, allocated before the thread starts
+};
+
+
+static int deque_init(struct deque *d, int capacity)
+{
+    d->tasks = malloc(capacity * sizeof(*d->tasks));
+    d->capacity = capacity;
+    d->top = 0;
+    d->bottom = 0;
+    pthread_mutex_init(&d->lock, NULL);
+    return d->tasks == NULL ? -1 : 0;
+}
+
+static void deque_free(struct deque *d)
+{
+    pthread_mutex_destroy(&d->lock);
+    free(d->tasks);
+    return;
+}
+
+static int deque_push(struct deque *d, struct scan_task task) //owner side; -1 if it could not grow
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom == d->capacity) //compact, then grow if that was not enough
+    {
+        memmove(d->tasks, d->tasks + d->top, (d->bottom - d->top) * sizeof(*d->tasks));
+        d->bottom -= d->top;
+        d->top = 0;
+        if (d->bottom == d->capacity)
+        {
+            struct scan_task *grown = realloc(d->tasks, 2 * d->capacity * sizeof(*d->tasks));
+            if (grown == NULL)
+            {
+                pthread_mutex_unlock(&d->lock);
+                return -1;
+            }
+            d->tasks = grown;
+            d->capacity *= 2;
+        }
+    }
+    d->tasks[d->bottom++] = task;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+static int deque_pop(struct deque *d, struct scan_task *task) //owner side, newest first (cache warm)
+{
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top)
+    {
+        *task = d->tasks[--d->bottom];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+static int deque_steal(struct deque *d, struct scan_task *task) //thief side, oldest first (usually the biggest piece)
+{
+    int found = 0;
+    if (pthread_mutex_trylock(&d->lock) != 0)
+    {
+        return 0;
+    }
+    if (d->bottom > d->top)
+    {
+        *task = d->tasks[d->top++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+
+static uint64_t scan_range(int fd, off_t offset, off_t length, char *buffer) //reads the range and folds it into a checksum
+{
+    uint64_t sum = 0;
+    while (length > 0)
+    {
+        size_t want = length < SCAN_BUFFER ? (size_t)length : SCAN_BUFFER;
+        ssize_t x = pread(fd, buffer, want, offset);
+        if (x <= 0)
+        {
+            break;
+        }
+        for (ssize_t i = 0; i + 8 <= x; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, buffer + i, 8);
+            sum += word;
+        }
+        offset += x;
+        length -= x;
+    }
+    return sum;
+}
+
+static void scan_wake(struct scan_pool *pool) //new tasks or the end of the scan: every idle worker looks again
+{
+    pthread_mutex_lock(&pool->idle_lock);
+    __atomic_add_fetch(&pool->posted, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+    return;
+}
+
+static void *scan_thread(void *arg)
+{
+    struct scan_worker *worker = arg;
+    struct scan_pool *pool = worker->pool;
+    struct deque *own = &pool->deques[worker->id];
+    char *buffer = worker->buffer;
+    uint64_t sum = 0;
+    long steals = 0;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker->id % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+    while (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) > 0)
+    {
+        long posted = __atomic_load_n(&pool->posted, __ATOMIC_ACQUIRE); //before the deques, so a push after them is not slept through
+        struct scan_task task;
+        int found = deque_pop(own, &task);
+        for (int i = 1; !found && i < pool->threads; i++)
+        {
+            found = deque_steal(&pool->deques[(worker->id + i) % pool->threads], &task);
+            steals += found;
+        }
+        if (!found) //park until something is pushed or the scan is over, so the busy workers keep their cores
+        {
+            pthread_mutex_lock(&pool->idle_lock);
+            while (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) > 0 && __atomic_load_n(&pool->posted, __ATOMIC_ACQUIRE) == posted)
+            {
+                pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+            }
+            pthread_mutex_unlock(&pool->idle_lock);
+            continue;
+        }
+
+        if (task.whole && task.length > SCAN_SPLIT) //keep the first chunk, expose the rest to thieves, last chunk first
+        {
+            off_t end = task.offset + task.length;
+            for (off_t off = task.offset + (task.length - 1) / SCAN_SPLIT * SCAN_SPLIT; off > task.offset; off -= SCAN_SPLIT)
+            {
+                struct scan_task chunk = {task.file, off, end - off, 0};
+                __atomic_add_fetch(&pool->pending, 1, __ATOMIC_RELEASE);
+                if (deque_push(own, chunk) < 0) //out of memory: what was not pushed stays with this task
+                {
+                    __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_RELEASE);
+                    break;
+                }
+                end = off;
+            }
+            if (end < task.offset + task.length)
+            {
+                scan_wake(pool);
+            }
+            task.length = end - task.offset;
+        }
+
+        sum += scan_range(pool->fds[task.file], task.offset, task.length, buffer);
+        if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_RELEASE) == 0)
+        {
+            scan_wake(pool);
+        }
+    }
+
+    __atomic_add_fetch(&pool->checksum, sum, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pool->steals, steals, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+
+static int write_scan_file(const char *dir, int i, off_t size) //fills with a position dependent pattern
+{
+    char path[128];
+    char a[CHUNK_SIZE];
+    snprintf(path, sizeof(path), SCAN_DIR "/%s/f%04d", dir, i);
+
+    struct stat st;
+    if (stat(path, &st) == 0 && st.st_size == size)
+    {
+        return 0;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror("Error Creating Scan File");
+        return -1;
+    }
+    for (off_t done = 0; done < size; done += sizeof(a))
+    {
+        memset(a, (int)(done / sizeof(a) + i), sizeof(a));
+        size_t len = (size - done < (off_t)sizeof(a)) ? (size_t)(size - done) : sizeof(a);
+        if (write(fd, a, len) != (ssize_t)len)
+        {
+            perror("Error Writing Scan File");
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+static int generate_scan_set(const char *dir) //uniform, skewed (one huge file) or mixed (16 KB .. 8 MB) sizes
+{
+    char path[128];
+    mkdir(SCAN_DIR, 0755);
+    snprintf(path, sizeof(path), SCAN_DIR "/%s", dir);
+    if (mkdir(path, 0755) < 0 && errno != EEXIST)
+    {
+        perror("Error Creating Directory");
+        return -1;
+    }
+
+    int ok = 0;
+    if (strcmp(dir, "uniform") == 0)
+    {
+        for (int i = 0; i < 96 && ok == 0; i++)
+        {
+            ok = write_scan_file(dir, i, 1024 * 1024);
+        }
+    }
+    else if (strcmp(dir, "skewed") == 0)
+    {
+        ok = write_scan_file(dir, 0, 64 * 1024 * 1024);
+        for (int i = 1; i <= 128 && ok == 0; i++)
+        {
+            ok = write_scan_file(dir, i, 256 * 1024);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < 40 && ok == 0; i++)
+        {
+            ok = write_scan_file(dir, i, (off_t)16 * 1024 << (i % 10));
+        }
+    }
+    return ok;
+}
+
+static void scan_pool_free(struct scan_pool *pool, int deques)
+{
+    for (int f = 0; f < pool->files; f++)
+    {
+        close(pool->fds[f]);
+    }
+    for (int t = 0; t < deques; t++)
+    {
+        deque_free(&pool->deques[t]);
+    }
+    pthread_cond_destroy(&pool->idle_cond);
+    pthread_mutex_destroy(&pool->idle_lock);
+    free(pool);
+    return;
+}
+
+static double scan_directory(const char *dir, int threads, long *steals, double *megabytes, uint64_t *checksum) //one timed scan, -1 on error
+{
+    struct scan_pool *pool = calloc(1, sizeof(*pool));
+    pthread_t tids[SCAN_MAX_THREADS];
+    struct scan_worker workers[SCAN_MAX_THREADS];
+    char path[128];
+    if (pool == NULL)
+    {
+        return -1;
+    }
+    pool->threads = threads;
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+
+    double start = timestamp();
+
+    //list the directory and hand out whole files round robin
+    snprintf(path, sizeof(path), SCAN_DIR "/%s", dir);
+    DIR *d = opendir(path);
+    if (d == NULL)
+    {
+        perror("Error Opening Directory");
+        scan_pool_free(pool, 0);
+        return -1;
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        if (deque_init(&pool->deques[t], 64) < 0)
+        {
+            perror("Error Allocating Deque");
+            closedir(d);
+            scan_pool_free(pool, t + 1);
+            return -1;
+        }
+    }
+    off_t total = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL && pool->files < SCAN_MAX_FILES)
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        int fd = openat(dirfd(d), entry->d_name, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0)
+        {
+            perror("Error Opening File");
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            continue;
+        }
+        int f = pool->files++;
+        pool->fds[f] = fd;
+        pool->sizes[f] = st.st_size;
+        total += st.st_size;
+        struct scan_task task = {f, 0, st.st_size, 1};
+        if (deque_push(&pool->deques[f % threads], task) < 0)
+        {
+            perror("Error Allocating Deque");
+            closedir(d);
+            scan_pool_free(pool, threads);
+            return -1;
+        }
+        pool->pending++;
+    }
+    closedir(d);
+
+    for (int t = 0; t < threads; t++) //buffers first, so a failed allocation leaves no task without a worker
+    {
+        workers[t].buffer = malloc(SCAN_BUFFER);
+        if (workers[t].buffer == NULL)
+        {
+            perror("Error Allocating Buffer");
+            while (t-- > 0)
+            {
+                free(workers[t].buffer);
+            }
+            scan_pool_free(pool, threads);
+            return -1;
+        }
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t].pool = pool;
+        workers[t].id = t;
+        pthread_create(&tids[t], NULL, scan_thread, &workers[t]);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(tids[t], NULL);
+        free(workers[t].buffer);
+    }
+
+    double elapsed = timestamp() - start;
+
+    *steals = pool->steals;
+    *megabytes = total / (1024.0 * 1024.0);
+    *checksum = pool->checksum;
+    scan_pool_free(pool, threads);
+    return elapsed;
+}
+
+
+void dirscan(int runs, int max_threads) //throughput of the work stealing scan for 1..max_threads threads per size distribution
+{
+    const char *sets[] = {"uniform", "skewed", "mixed"};
+    if (max_threads > SCAN_MAX_THREADS)
+    {
+        max_threads = SCAN_MAX_THREADS;
+    }
+
+    printf("Parallel directory scan, work stealing (%d runs each)\n", runs);
+    for (int s = 0; s < 3; s++)
+    {
+        if (generate_scan_set(sets[s]) < 0)
+        {
+            return;
+        }
+
+        printf("//////////////////////////////////////\n");
+        printf("-:- %s\n", sets[s]);
+        printf("//////////////////////////////////////\n");
+        double base = 0;
+        uint64_t expect = 0;
+        for (int threads = 1; threads <= max_threads; threads *= 2)
+        {
+            double total = 0;
+            double megabytes = 0;
+            long steals = 0;
+            int mismatch = 0;
+            for (int i = 0; i < runs; i++)
+            {
+                long st;
+                uint64_t checksum;
+                double t = scan_directory(sets[s], threads, &st, &megabytes, &checksum);
+                if (t < 0)
+                {
+                    return;
+                }
+                if (threads == 1 && i == 0)
+                {
+                    expect = checksum;
+                }
+                mismatch |= checksum != expect;
+                total += t;
+                steals += st;
+            }
+            double rate = megabytes * runs / total;
+            if (threads == 1)
+            {
+                base = rate;
+            }
+            printf("%2d threads: %9.1f MB/s  speedup %5.2fx  steals/run %ld  checksum %016llx%s\n", threads, rate, rate / base,
+                   steals / runs, (unsigned long long)expect, mismatch ? " MISMATCH" : "");
+        }
+    }
+    printf("//////////////////////////////////////\n");
+    return;
+}
@@ -0,0 +1,170 @@
+#define _GNU_SOURCE //fallocate, sync_file_range
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "time_sys_stdio.h"
+
+
+//user defines
+#define GENERATE_BLOCK (1024 * 1024)
+#define GENERATE_WINDOW (256LL * 1024 * 1024) //written data is flushed and dropped from the page cache per window
+
+
+off_t parse_size(const char *text)
+{
+    char *end;
+    errno = 0;
+    long long value = strtoll(text, &end, 10);
+    if (end == text || value < 0 || errno == ERANGE)
+    {
+        return -1;
+    }
+    long long multiplier = 1;
+    switch (toupper((unsigned char)*end))
+    {
+        case 'T': multiplier = 1LL << 40; break;
+        case 'G': multiplier = 1LL << 30; break;
+        case 'M': multiplier = 1LL << 20; break;
+        case 'K': multiplier = 1LL << 10; break;
+        case '\0': break;
+        default: return -1;
+    }
+    if (*end != '\0' && end[1] != '\0') //"4G" only, not "4GB" or "4Gxyz"
+    {
+        return -1;
+    }
+    if (value > LLONG_MAX / multiplier) //would wrap into a small or negative size
+    {
+        return -1;
+    }
+    return (off_t)(value * multiplier);
+}
+
+static void fill_block(char *block, char content, uint64_t *state) //one GENERATE_BLOCK of the requested content
+{
+    if (content == 'z')
+    {
+        memset(block, 0, GENERATE_BLOCK);
+        return;
+    }
+    for (size_t i = 0; i < GENERATE_BLOCK; i += 8)
+    {
+        //compressible: the second half of every 4 KB page is zero, so roughly 2:1
+        if (content == 'c' && (i & 4095) >= 2048)
+        {
+            memset(block + i, 0, 8);
+            continue;
+        }
+        uint64_t x = *state; //xorshift64
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        *state = x;
+        memcpy(block + i, &x, 8);
+    }
+    return;
+}
+
+int generate(const char *path, off_t size, char content, char allocation) //creates path with size bytes; 0 on success
+{
+    if (size < 0 || (content != 'z' && content != 'r' && content != 'c') ||
+        (allocation != 'w' && allocation != 'f' && allocation != 's'))
+    {
+        fprintf(stderr, "Invalid size, content or allocation\n");
+        return -1;
+    }
+    if (allocation == 's' && content != 'z')
+    {
+        fprintf(stderr, "Sparse files can only hold zeros\n");
+        return -1;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror("Error Creating File");
+        return -1;
+    }
+
+    double start = timestamp();
+    if (allocation == 's') //holes only, nothing touches the disk
+    {
+        if (ftruncate(fd, size) < 0)
+        {
+            perror("Error Sizing File");
+            close(fd);
+            return -1;
+        }
+        close(fd);
+        printf("Created sparse %s of %lld Bytes\n", path, (long long)size);
+        return 0;
+    }
+
+    if (allocation == 'f' && size > 0)
+    {
+        if (fallocate(fd, 0, 0, size) == 0)
+        {
+            if (content == 'z') //allocated extents already read back as zeros
+            {
+                close(fd);
+                printf("Created preallocated %s of %lld Bytes in %f seconds\n", path, (long long)size, timestamp() - start);
+                return 0;
+            }
+        }
+        else if (errno != EOPNOTSUPP)
+        {
+            perror("Error Allocating File");
+            close(fd);
+            return -1;
+        }
+        //no fallocate on this filesystem: fall back to writing the data out
+    }
+
+    char *block = malloc(GENERATE_BLOCK);
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    if (block == NULL)
+    {
+        close(fd);
+        return -1;
+    }
+    fill_block(block, content, &state);
+
+    off_t window = 0;
+    for (off_t done = 0; done < size;)
+    {
+        size_t len = (size - done < GENERATE_BLOCK) ? (size_t)(size - done) : GENERATE_BLOCK;
+        ssize_t x = pwrite(fd, block, len, done);
+        if (x <= 0)
+        {
+            perror("Error Writing File");
+            free(block);
+            close(fd);
+            return -1;
+        }
+        done += x;
+        if (content != 'z')
+        {
+            fill_block(block, content, &state);
+        }
+
+        //keep the page cache from filling up with our own dirty data, which matters beyond RAM size
+        if (done - window >= GENERATE_WINDOW || done == size)
+        {
+            sync_file_range(fd, window, done - window, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            posix_fadvise(fd, window, done - window, POSIX_FADV_DONTNEED);
+            window = done;
+        }
+    }
+
+    free(block);
+    close(fd);
+    printf("Created %s of %lld Bytes in %f seconds\n", path, (long long)size, timestamp() - start);
+    return 0;
+}
@@ -0,0 +1,187 @@
+#define _GNU_SOURCE //vmsplice, splice, F_SETPIPE_SZ
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include "time_sys_stdio.h"
+
+
+//user defines
+#define IPC_BYTES (50000LL * 1024) //the same 50 MB as the default file.txt
+#define IPC_MAX_CHUNK (1024 * 1024)
+
+
+static const size_t ipc_chunks[] = {4096, 16384, 65536, 262144, 1048576};
+
+
+struct ipc_side
+{
+    int fd;
+    size_t chunk;
+    char how; //producer: 'w'rite or 'v'msplice; consumer: 'r'ead or 's'plice into /dev/null
+    char *buf;
+    long long bytes;
+    int failed;
+};
+
+static void *ipc_producer(void *arg) //pushes IPC_BYTES and closes its end so the consumer sees EOF
+{
+    struct ipc_side *p = arg;
+    long long left = IPC_BYTES;
+    while (left > 0)
+    {
+        size_t len = left < (long long)p->chunk ? (size_t)left : p->chunk;
+        ssize_t x;
+        if (p->how == 'v')
+        {
+            //the pipe references our pages instead of copying them; safe here because buf never changes
+            struct iovec iov = {p->buf, len};
+            x = vmsplice(p->fd, &iov, 1, 0);
+        }
+        else
+        {
+            x = write(p->fd, p->buf, len);
+        }
+        if (x <= 0)
+        {
+            perror("Error Writing to Pipe");
+            p->failed = 1;
+            break;
+        }
+        left -= x;
+        p->bytes += x;
+    }
+    close(p->fd);
+    return NULL;
+}
+
+static void ipc_consume(struct ipc_side *c, int devnull)
+{
+    ssize_t x;
+    do
+    {
+        if (c->how == 's')
+        {
+            x = splice(c->fd, NULL, devnull, NULL, c->chunk, SPLICE_F_MOVE);
+        }
+        else
+        {
+            x = read(c->fd, c->buf, c->chunk);
+        }
+        c->bytes += x > 0 ? x : 0;
+    }
+    while (x > 0);
+    if (x < 0)
+    {
+        perror("Error Reading from Pipe");
+        c->failed = 1;
+    }
+    return;
+}
+
+//one transfer of IPC_BYTES; returns the time taken or -1. pipe_size 0 keeps the kernel default
+static double ipc_once(char kind, int pipe_size, char producer, char consumer, size_t chunk, char *src, char *dst, int devnull, int *actual)
+{
+    int fds[2];
+    if (kind == 's' ? socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0 : pipe(fds) < 0)
+    {
+        perror("Error Creating Channel");
+        return -1;
+    }
+    if (kind == 'p')
+    {
+        if (pipe_size > 0)
+        {
+            fcntl(fds[1], F_SETPIPE_SZ, pipe_size); //capped by /proc/sys/fs/pipe-max-size for unprivileged users
+        }
+        *actual = fcntl(fds[1], F_GETPIPE_SZ);
+    }
+
+    struct ipc_side p = {fds[1], chunk, producer, src, 0, 0};
+    struct ipc_side c = {fds[0], chunk, consumer, dst, 0, 0};
+    pthread_t thread;
+    double start = timestamp();
+    if (pthread_create(&thread, NULL, ipc_producer, &p) != 0)
+    {
+        perror("Error Creating Thread");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    ipc_consume(&c, devnull);
+    pthread_join(thread, NULL);
+    double t = timestamp() - start;
+    close(fds[0]);
+    return (p.failed || c.failed || c.bytes != IPC_BYTES) ? -1 : t;
+}
+
+static void ipc_row(const char *name, char kind, int pipe_size, char producer, char consumer, size_t chunk, int runs,
+                    char *src, char *dst, int devnull)
+{
+    double total = 0;
+    int actual = 0;
+    for (int i = 0; i < runs; i++)
+    {
+        double t = ipc_once(kind, pipe_size, producer, consumer, chunk, src, dst, devnull, &actual);
+        if (t < 0)
+        {
+            printf("%-22s %7s: failed\n", name, "");
+            return;
+        }
+        total += t;
+    }
+    char buffer[16] = "";
+    if (kind == 'p')
+    {
+        snprintf(buffer, sizeof(buffer), "%dK", actual / 1024);
+    }
+    printf("%-22s %7s: %9.1f MB/s\n", name, buffer, IPC_BYTES / (1024.0 * 1024.0) * runs / total);
+    return;
+}
+
+void ipc_streams(int runs, int pipe_size) //producer thread -> consumer thread, pipes at the default size and at pipe_size
+{
+    char *src = malloc(IPC_MAX_CHUNK);
+    char *dst = malloc(IPC_MAX_CHUNK);
+    int devnull = open("/dev/null", O_WRONLY);
+    if (src == NULL || dst == NULL || devnull < 0)
+    {
+        perror("Error Allocating Buffers");
+        free(src);
+        free(dst);
+        if (devnull >= 0)
+        {
+            close(devnull);
+        }
+        return;
+    }
+    memset(src, 'a', IPC_MAX_CHUNK);
+    memset(dst, 0, IPC_MAX_CHUNK); //fault the pages in outside the timed part
+
+    printf("Streaming %lld Bytes between two threads (%d runs each); second column is the pipe buffer size\n", IPC_BYTES, runs);
+    for (size_t i = 0; i < sizeof(ipc_chunks) / sizeof(ipc_chunks[0]); i++)
+    {
+        size_t chunk = ipc_chunks[i];
+        printf("////////////////// chunk %zu Bytes //////////////////\n", chunk);
+        const int sizes[] = {0, pipe_size};
+        for (int s = 0; s < 2; s++)
+        {
+            ipc_row("pipe write/read", 'p', sizes[s], 'w', 'r', chunk, runs, src, dst, devnull);
+            ipc_row("pipe vmsplice/read", 'p', sizes[s], 'v', 'r', chunk, runs, src, dst, devnull);
+            ipc_row("pipe vmsplice/splice", 'p', sizes[s], 'v', 's', chunk, runs, src, dst, devnull);
+        }
+        ipc_row("socketpair write/read", 's', 0, 'w', 'r', chunk, runs, src, dst, devnull);
+    }
+    printf("//////////////////////////////////////\n");
+    printf("vmsplice/splice never copies the payload; it is the upper bound for a consumer that only forwards bytes\n");
+
+    close(devnull);
+    free(src);
+    free(dst);
+    return;
+}
@@ -0,0 +1,241 @@
+#define _GNU_SOURCE //O_DIRECT, preadv2, RUSAGE_THREAD
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "time_sys_stdio.h"
+#include "uring.h"
+
+
+//user defines
+#define LATENCY_BYTES (16LL * 1024 * 1024) //read from a cold file per variant
+#define LATENCY_ALIGN 4096 //O_DIRECT buffer and offset alignment
+
+
+struct sched_sample //what the scheduler says about this thread
+{
+    double run_delay; //seconds spent runnable but not running (schedstat)
+    long nvcsw; //voluntary context switches, i.e. times this thread went to sleep
+    double cpu; //user + sys
+};
+
+static void sched_now(struct sched_sample *s)
+{
+    unsigned long long run = 0, delay = 0;
+    FILE *file = fopen("/proc/thread-self/schedstat", "r");
+    if (file != NULL)
+    {
+        if (fscanf(file, "%llu %llu", &run, &delay) != 2)
+        {
+            delay = 0;
+        }
+        fclose(file);
+    }
+    s->run_delay = delay / 1000000000.0;
+
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    s->nvcsw = ru.ru_nvcsw;
+    s->cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0;
+    return;
+}
+
+
+struct latency_run
+{
+    int fd;
+    char *buf;
+    size_t block;
+    off_t bytes;
+    long spin_us; //io_uring: busy-poll this long before sleeping; <0 spins forever, 0 sleeps at once
+    double *latency;
+    long reads;
+};
+
+static int latency_pread(struct latency_run *r) //plain blocking reads: sleep in the kernel until the I/O completes
+{
+    for (off_t off = 0; off < r->bytes; off += r->block)
+    {
+        double start = timestamp();
+        ssize_t x = pread(r->fd, r->buf, r->block, off);
+        r->latency[r->reads++] = timestamp() - start;
+        if (x <= 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int latency_hipri(struct latency_run *r) //RWF_HIPRI: the kernel polls the device queue instead of sleeping, where it has poll queues
+{
+    for (off_t off = 0; off < r->bytes; off += r->block)
+    {
+        struct iovec iov = {r->buf, r->block};
+        double start = timestamp();
+        ssize_t x = preadv2(r->fd, &iov, 1, off, RWF_HIPRI);
+        r->latency[r->reads++] = timestamp() - start;
+        if (x <= 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int latency_uring(struct latency_run *r) //one read in flight; spin on the completion ring for spin_us, then block
+{
+    struct uring ring;
+    if (uring_init(&ring, 4) < 0)
+    {
+        return -1;
+    }
+    int failed = 0;
+    for (off_t off = 0; off < r->bytes && !failed; off += r->block)
+    {
+        struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = r->fd;
+        sqe->addr = (unsigned long)r->buf;
+        sqe->len = r->block;
+        sqe->off = off;
+
+        double start = timestamp();
+        struct io_uring_cqe *cqe = NULL;
+        if (uring_submit(&ring, r->spin_us == 0 ? 1 : 0) < 0)
+        {
+            failed = 1;
+            break;
+        }
+        double deadline = start + r->spin_us / 1000000.0;
+        while ((cqe = uring_peek_cqe(&ring)) == NULL && (r->spin_us < 0 || timestamp() < deadline))
+        {
+            //busy poll: the completion ring is shared memory, no syscall needed to see the result
+        }
+        if (cqe == NULL) //spin budget used up: sleep until it arrives
+        {
+            if (uring_submit(&ring, 1) < 0)
+            {
+                failed = 1;
+                break;
+            }
+            cqe = uring_peek_cqe(&ring);
+        }
+        r->latency[r->reads++] = timestamp() - start;
+        failed = cqe == NULL || cqe->res <= 0;
+        uring_cqe_seen(&ring);
+    }
+    uring_exit(&ring);
+    return failed ? -1 : 0;
+}
+
+
+static int open_cold(int *direct) //O_DIRECT where the filesystem allows it, else a dropped page cache with readahead off
+{
+    int fd = open(file_name, O_RDONLY | O_DIRECT);
+    *direct = fd >= 0;
+    if (fd < 0)
+    {
+        fd = open(file_name, O_RDONLY);
+    }
+    if (fd >= 0)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM); //every read has to go to the device, not to readahead
+    }
+    return fd;
+}
+
+static void run_latency(const char *name, int (*fn)(struct latency_run *), long spin_us, size_t block, off_t bytes, char *buf, double *samples)
+{
+    struct latency_run r;
+    int direct;
+    r.fd = open_cold(&direct);
+    if (r.fd < 0)
+    {
+        perror("Error Opening File");
+        return;
+    }
+    r.buf = buf;
+    r.block = block;
+    r.bytes = bytes;
+    r.spin_us = spin_us;
+    r.latency = samples;
+    r.reads = 0;
+
+    struct sched_sample before, after;
+    sched_now(&before);
+    double start = timestamp();
+    int rc = fn(&r);
+    double wall = timestamp() - start;
+    sched_now(&after);
+    close(r.fd);
+
+    if (rc < 0 || r.reads == 0)
+    {
+        printf("%-22s: failed\n", name);
+        return;
+    }
+    double mb = r.reads * (double)block / (1024.0 * 1024.0);
+    sort_samples(samples, r.reads);
+    printf("%-22s: p50 %8.1f us  p99 %8.1f us  runqueue wait %6.2f us/read  %8.1f vol. switches/MB  CPU %3.0f%%%s\n", name,
+           percentile(samples, r.reads, 50) * 1e6, percentile(samples, r.reads, 99) * 1e6,
+           (after.run_delay - before.run_delay) / r.reads * 1e6, (after.nvcsw - before.nvcsw) / mb,
+           100.0 * (after.cpu - before.cpu) / wall, direct ? "" : "  (buffered)");
+    return;
+}
+
+void latency(size_t block, long spin_us) //cold single reads of block Bytes: sleeping vs polling for the completion
+{
+    struct stat st;
+    if (stat(file_name, &st) < 0)
+    {
+        perror("Error Opening File");
+        return;
+    }
+    block = (block + LATENCY_ALIGN - 1) / LATENCY_ALIGN * LATENCY_ALIGN;
+    if (block == 0) //0, or so large that rounding up wrapped
+    {
+        fprintf(stderr, "Block size must be between 1 and %zu Bytes\n", (size_t)-1 - LATENCY_ALIGN + 1);
+        return;
+    }
+    off_t bytes = st.st_size < LATENCY_BYTES ? st.st_size : LATENCY_BYTES;
+    bytes = bytes / block * block;
+    if (bytes == 0)
+    {
+        fprintf(stderr, "%s is smaller than one block\n", file_name);
+        return;
+    }
+    char *buf = aligned_alloc(LATENCY_ALIGN, block);
+    double *samples = malloc((bytes / block) * sizeof(double));
+    if (buf == NULL || samples == NULL)
+    {
+        perror("Error Allocating Buffers");
+        free(buf);
+        free(samples);
+        return;
+    }
+    memset(buf, 0, block);
+
+    char spin_name[32];
+    snprintf(spin_name, sizeof(spin_name), "io_uring spin %ldus", spin_us);
+    printf("Cold reads of %s: %lld Bytes in %zu Byte blocks, one at a time\n", file_name, (long long)bytes, block);
+    printf("runqueue wait is the time between being woken and running again (schedstat run_delay)\n");
+    printf("//////////////////////////////////////\n");
+    run_latency("pread (sleeps)", latency_pread, 0, block, bytes, buf, samples);
+    run_latency("preadv2 RWF_HIPRI", latency_hipri, 0, block, bytes, buf, samples);
+    run_latency("io_uring (sleeps)", latency_uring, 0, block, bytes, buf, samples);
+    run_latency(spin_name, latency_uring, spin_us, block, bytes, buf, samples);
+    run_latency("io_uring spin", latency_uring, -1, block, bytes, buf, samples);
+    printf("//////////////////////////////////////\n");
+    printf("RWF_HIPRI only polls on O_DIRECT files whose device has poll queues (/sys/block/*/queue/io_poll); otherwise it sleeps like pread\n");
+
+    free(buf);
+    free(samples);
+    return;
+}
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE //posix_fadvise
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "time_sys_stdio.h"
+
+
+//user defines
+#define NOISE_MAX_THREADS 16
+#define NOISE_COPY_SIZE (64 * 1024 * 1024) //per memcpy thread, well beyond the LLC
+#define NOISE_FILE_SIZE (256 * 1024 * 1024) //per page cache / writer thread
+#define NOISE_BLOCK (1024 * 1024)
+#define NOISE_SINGLE_SAMPLES 1000 //samples for single call engines
+#define NOISE_FILE_SAMPLES 20 //samples for whole file engines
+
+
+static pthread_t noise_threads[NOISE_MAX_THREADS];
+static int noise_count = 0;
+static int noise_running = 0;
+
+
+static int running()
+{
+    return __atomic_load_n(&noise_running, __ATOMIC_RELAXED);
+}
+
+
+static void *noise_memcpy(void *arg) //streams between two large buffers to eat memory bandwidth
+{
+    char *src = malloc(NOISE_COPY_SIZE);
+    char *dst = malloc(NOISE_COPY_SIZE);
+    if (src != NULL && dst != NULL)
+    {
+        memset(src, 1, NOISE_COPY_SIZE);
+        while (running())
+        {
+            memcpy(dst, src, NOISE_COPY_SIZE);
+            memcpy(src, dst, NOISE_COPY_SIZE);
+        }
+    }
+    free(src);
+    free(dst);
+    return NULL;
+}
+
+static void *noise_pagecache(void *arg) //churns its own file through the page cache and keeps evicting file_name
+{
+    long id = (long)arg;
+    char path[64];
+    char *a = malloc(NOISE_BLOCK);
+    snprintf(path, sizeof(path), "noise_cache_%ld.bin", id);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int victim = open(file_name, O_RDONLY);
+    if (fd < 0 || victim < 0 || a == NULL)
+    {
+        perror("Error Opening Noise File");
+    }
+    else
+    {
+        memset(a, 2, NOISE_BLOCK);
+        for (off_t off = 0; off < NOISE_FILE_SIZE && running(); off += NOISE_BLOCK)
+        {
+            if (write(fd, a, NOISE_BLOCK) != NOISE_BLOCK)
+            {
+                break;
+            }
+        }
+        while (running())
+        {
+            for (off_t off = 0; off < NOISE_FILE_SIZE && running(); off += NOISE_BLOCK)
+            {
+                if (pread(fd, a, NOISE_BLOCK, off) <= 0)
+                {
+                    break;
+                }
+            }
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            posix_fadvise(victim, 0, 0, POSIX_FADV_DONTNEED);
+        }
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+        unlink(path);
+    }
+    if (victim >= 0)
+    {
+        close(victim);
+    }
+    free(a);
+    return NULL;
+}
+
+static void *noise_writer(void *arg) //sequential writer that wraps around its file, forcing writeback every 64 MB
+{
+    long id = (long)arg;
+    char path[64];
+    char *a = malloc(NOISE_BLOCK);
+    snprintf(path, sizeof(path), "noise_write_%ld.bin", id);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || a == NULL)
+    {
+        perror("Error Opening Noise File");
+    }
+    else
+    {
+        memset(a, 3, NOISE_BLOCK);
+        off_t off = 0;
+        while (running())
+        {
+            if (pwrite(fd, a, NOISE_BLOCK, off) != NOISE_BLOCK)
+            {
+                break;
+            }
+            off = (off + NOISE_BLOCK) % NOISE_FILE_SIZE;
+            if (off % (64 * NOISE_BLOCK) == 0)
+            {
+                fdatasync(fd);
+            }
+        }
+        close(fd);
+        unlink(path);
+    }
+
+    free(a);
+    return NULL;
+}
+
+int noise_start(char kind, int intensity) //intensity = number of noise threads; 0 starts nothing
+{
+    void *(*fn)(void *);
+    if (kind == 'm')
+    {
+        fn = noise_memcpy;
+    }
+    else if (kind == 'c')
+    {
+        fn = noise_pagecache;
+    }
+    else if (kind == 'w')
+    {
+        fn = noise_writer;
+    }
+    else
+    {
+        fprintf(stderr, "Unknown noise kind: %c\n", kind);
+        return -1;
+    }
+
+    if (intensity > NOISE_MAX_THREADS)
+    {
+        intensity = NOISE_MAX_THREADS;
+    }
+    __atomic_store_n(&noise_running, 1, __ATOMIC_RELAXED);
+    for (noise_count = 0; noise_count < intensity; noise_count++)
+    {
+        if (pthread_create(&noise_threads[noise_count], NULL, fn, (void *)(long)noise_count) != 0)
+        {
+            perror("Error Starting Noise");
+            noise_stop();
+            return -1;
+        }
+    }
+    usleep(200000); //let the generators reach steady state before anything is measured
+    return 0;
+}
+
+void noise_stop()
+{
+    __atomic_store_n(&noise_running, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < noise_count; i++)
+    {
+        pthread_join(noise_threads[i], NULL);
+    }
+    noise_count = 0;
+    return;
+}
+
+
+void interference(const char *engines) //latency percentiles of each engine with rising noise of every kind
+{
+    const char kinds[] = {'m', 'c', 'w'};
+    const char *kind_names[] = {"memcpy bandwidth hog", "page cache thrasher", "sequential writer"};
+    const int levels[] = {0, 1, 2, 4};
+    static double samples[NOISE_SINGLE_SAMPLES];
+
+    printf("Read latency under co-running noise (engines: %s)\n", engines);
+    for (int k = 0; k < 3; k++)
+    {
+        printf("//////////////////////////////////////\n");
+        printf("-:- %s\n", kind_names[k]);
+        printf("//////////////////////////////////////\n");
+        for (const char *e = engines; *e != '\0'; e++)
+        {
+            int n = engine_single(*e) ? NOISE_SINGLE_SAMPLES : NOISE_FILE_SAMPLES;
+            for (int l = 0; l < 4; l++)
+            {
+                if (noise_start(kinds[k], levels[l]) < 0)
+                {
+                    return;
+                }
+                int i;
+                for (i = 0; i < n; i++)
+                {
+                    samples[i] = engine(*e);
+                    if (samples[i] < 0)
+                    {
+                        break;
+                    }
+                }
+                noise_stop();
+                if (i < n)
+                {
+                    fprintf(stderr, "Engine %c failed\n", *e);
+                    return;
+                }
+
+                sort_samples(samples, n);
+                printf("engine %c, %d noise threads: p50 %f  p90 %f  p99 %f  max %f seconds\n", *e, levels[l],
+                       percentile(samples, n, 50), percentile(samples, n, 90), percentile(samples, n, 99), samples[n - 1]);
+            }
+        }
+    }
+    printf("//////////////////////////////////////\n");
+    return;
+}
@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "time_sys_stdio.h"
+
+
+//user defines
+#define RECORD_FILE "records.bin"
+#define RECORD_SIZE 16 //on-disk size: u64 timestamp, u32 id, f32 value (little endian, no padding)
+#define RECORD_COUNT (50000 * 1024 / RECORD_SIZE) //same 50 MB as file.txt
+
+
+struct record //array-of-structures layout
+{
+    uint64_t timestamp;
+    uint32_t id;
+    float value;
+};
+
+struct columns //structure-of-arrays layout
+{
+    uint64_t *timestamp;
+    uint32_t *id;
+    float *value;
+};
+
+
+static int generate_records() //writes RECORD_FILE once; later runs reuse it if the size matches
+{
+    struct stat st;
+    if (stat(RECORD_FILE, &st) == 0 && st.st_size == (off_t)RECORD_COUNT * RECORD_SIZE)
+    {
+        return 0;
+    }
+
+    int fd = open(RECORD_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror("Error Creating Record File");
+        return -1;
+    }
+
+    unsigned char chunk[CHUNK_SIZE];
+    size_t used = 0;
+    for (uint32_t i = 0; i < RECORD_COUNT; i++)
+    {
+        struct record r;
+        r.timestamp = 1700000000000ULL + (uint64_t)i * 1000;
+        r.id = (i * 2654435761U) >> 22; //scattered ids in 0..1023
+        r.value = (float)(i % 1000) * 0.5f;
+
+        memcpy(chunk + used, &r.timestamp, 8);
+        memcpy(chunk + used + 8, &r.id, 4);
+        memcpy(chunk + used + 12, &r.value, 4);
+        used += RECORD_SIZE;
+
+        if (used == sizeof(chunk) || i == RECORD_COUNT - 1)
+        {
+            if (write(fd, chunk, used) != (ssize_t)used)
+            {
+                perror("Error Writing Record File");
+                close(fd);
+                return -1;
+            }
+            used = 0;
+        }
+    }
+
+    close(fd);
+    return 0;
+}
+
+
+//Decoders: turn n raw records at src into slot `at` onwards of the output
+static void decode_aos(const unsigned char *src, size_t n, struct record *out, size_t at)
+{
+    for (size_t i = 0; i < n; i++, src += RECORD_SIZE)
+    {
+        memcpy(&out[at + i].timestamp, src, 8);
+        memcpy(&out[at + i].id, src + 8, 4);
+        memcpy(&out[at + i].value, src + 12, 4);
+    }
+}
+
+static void decode_soa(const unsigned char *src, size_t n, struct columns *out, size_t at)
+{
+    for (size_t i = 0; i < n; i++, src += RECORD_SIZE)
+    {
+        memcpy(&out->timestamp[at + i], src, 8);
+        memcpy(&out->id[at + i], src + 8, 4);
+        memcpy(&out->value[at + i], src + 12, 4);
+    }
+}
+
+static void decode_soa_vector(const unsigned char *src, size_t n, struct columns *out, size_t at) //4 records per step
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= n; i += 4, src += 4 * RECORD_SIZE)
+    {
+        __m128i r0 = _mm_loadu_si128((const __m128i *)src);
+        __m128i r1 = _mm_loadu_si128((const __m128i *)(src + 16));
+        __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 32));
+        __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 48));
+
+        //low halves are the timestamps, high halves are (id, value) pairs
+        _mm_storeu_si128((__m128i *)&out->timestamp[at + i], _mm_unpacklo_epi64(r0, r1));
+        _mm_storeu_si128((__m128i *)&out->timestamp[at + i + 2], _mm_unpacklo_epi64(r2, r3));
+
+        __m128 hi01 = _mm_castsi128_ps(_mm_unpackhi_epi64(r0, r1)); //id0 v0 id1 v1
+        __m128 hi23 = _mm_castsi128_ps(_mm_unpackhi_epi64(r2, r3)); //id2 v2 id3 v3
+        _mm_storeu_si128((__m128i *)&out->id[at + i], _mm_castps_si128(_mm_shuffle_ps(hi01, hi23, _MM_SHUFFLE(2, 0, 2, 0))));
+        _mm_storeu_ps(&out->value[at + i], _mm_shuffle_ps(hi01, hi23, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+    decode_soa(src, n - i, out, at + i); //tail (or everything without SSE2)
+}
+
+static void decode(char layout, const unsigned char *src, size_t n, struct record *aos, struct columns *soa, size_t at)
+{
+    if (layout == 'a')
+    {
+        decode_aos(src, n, aos, at);
+    }
+    else if (layout == 's')
+    {
+        decode_soa(src, n, soa, at);
+    }
+    else
+    {
+        decode_soa_vector(src, n, soa, at);
+    }
+}
+
+
+//I/O paths: both return the number of records decoded, or -1
+static long read_records_syscall(char layout, struct record *aos, struct columns *soa) //chunked read() like file_per_chunk_syscall()
+{
+    int fd = open(RECORD_FILE, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error Opening File");
+        return -1;
+    }
+
+    unsigned char a[CHUNK_SIZE];
+    size_t have = 0;
+    size_t count = 0;
+    ssize_t x;
+
+    while ((x = read(fd, a + have, sizeof(a) - have)) > 0)
+    {
+        have += x;
+        size_t n = have / RECORD_SIZE;
+        if (count + n > RECORD_COUNT)
+        {
+            n = RECORD_COUNT - count;
+        }
+        decode(layout, a, n, aos, soa, count);
+        count += n;
+
+        //keep a partial trailing record for the next read
+        size_t left = have - n * RECORD_SIZE;
+        memmove(a, a + n * RECORD_SIZE, left);
+        have = left;
+    }
+
+    close(fd);
+    return x < 0 ? -1 : (long)count;
+}
+
+static long read_records_mmap(char layout, struct record *aos, struct columns *soa) //decode straight out of the mapping
+{
+    int fd = open(RECORD_FILE, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error Opening File");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        perror("Error Reading File Size");
+        close(fd);
+        return -1;
+    }
+
+    size_t n = st.st_size / RECORD_SIZE;
+    if (n > RECORD_COUNT)
+    {
+        n = RECORD_COUNT;
+    }
+
+    unsigned char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("Error Mapping File");
+        return -1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    decode(layout, map, n, aos, soa, 0);
+
+    munmap(map, st.st_size);
+    return (long)n;
+}
+
+
+//Consumers: one pass over the value field, which is what the layout choice is about
+static double scan_aos(const struct record *aos, size_t n)
+{
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += aos[i].value;
+    }
+    return sum;
+}
+
+static double scan_soa(const struct columns *soa, size_t n)
+{
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += soa->value[i];
+    }
+    return sum;
+}
+
+
+static void run_records(char io, char layout, int runs, struct record *aos, struct columns *soa) //averages decode and scan rate over runs
+{
+    double decode_time = 0;
+    double scan_time = 0;
+    double sum = 0;
+    long n = 0;
+
+    for (int i = 0; i < runs; i++)
+    {
+        double start = timestamp();
+        n = (io == 'r') ? read_records_syscall(layout, aos, soa) : read_records_mmap(layout, aos, soa);
+        double mid = timestamp();
+        if (n < 0)
+        {
+            return;
+        }
+        sum = (layout == 'a') ? scan_aos(aos, n) : scan_soa(soa, n);
+        double end = timestamp();
+
+        decode_time += mid - start;
+        scan_time += end - mid;
+    }
+
+    const char *io_name = (io == 'r') ? "read()" : "mmap";
+    const char *layout_name = (layout == 'a') ? "AoS" : (layout == 's') ? "SoA" : "SoA (vector)";
+    printf("%-7s %-13s decode: %8.2f M records/s  scan: %8.2f M records/s  (checksum %.1f)\n",
+           io_name, layout_name, n * runs / decode_time / 1e6, n * runs / scan_time / 1e6, sum);
+}
+
+void records(int runs) //fixed-width binary records into AoS and SoA, through the chunked reader and mmap
+{
+    if (generate_records() < 0)
+    {
+        return;
+    }
+
+    struct record *aos = malloc(RECORD_COUNT * sizeof(*aos));
+    struct columns soa;
+    soa.timestamp = malloc(RECORD_COUNT * sizeof(*soa.timestamp));
+    soa.id = malloc(RECORD_COUNT * sizeof(*soa.id));
+    soa.value = malloc(RECORD_COUNT * sizeof(*soa.value));
+    if (aos == NULL || soa.timestamp == NULL || soa.id == NULL || soa.value == NULL)
+    {
+        perror("Error Allocating Records");
+        free(aos);
+        free(soa.timestamp);
+        free(soa.id);
+        free(soa.value);
+        return;
+    }
+
+    printf("Decode %d records of %d Bytes (%d runs each)\n", RECORD_COUNT, RECORD_SIZE, runs);
+    printf("//////////////////////////////////////\n");
+    const char ios[] = {'r', 'm'};
+    const char layouts[] = {'a', 's', 'v'};
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            run_records(ios[i], layouts[j], runs, aos, &soa);
+        }
+    }
+    printf("//////////////////////////////////////\n");
+
+    free(aos);
+    free(soa.timestamp);
+    free(soa.id);
+    free(soa.value);
+    return;
+}
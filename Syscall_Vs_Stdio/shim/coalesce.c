@@ -0,0 +1,623 @@
+/*
+ * coalesce.c - LD_PRELOAD shim that serves small read()s from a per-fd readahead window
+ *
+ * usage: LD_PRELOAD=./coalesce.so ./time_sys_stdio
+ *        COALESCE_BUFFER=<bytes> sets the window size (default 64 KB)
+ *        COALESCE_STATS=1 prints hit/miss counters to stderr at exit
+ *
+ * Only regular files opened for reading are handled; everything else goes straight through.
+ * The file offset of a handled fd is kept virtually: small reads are served from the window,
+ * the window is refilled with pread(), and lseek(SEEK_SET/SEEK_CUR) only moves the virtual
+ * offset. The kernel offset is brought up to date before anything else can observe it
+ * (write, readv, dup, fork).
+ *
+ * Invalidation:
+ *   write/pwrite/ftruncate  drop the windows of every handled fd on the same inode
+ *   lseek                   moves the virtual offset; the window stays valid
+ *   dup/dup2/dup3/F_DUPFD   sync the offset and stop handling both fds (they now share it)
+ *   fork                    sync every fd and stop handling them (parent and child share offsets)
+ *   close/open              forget whatever was known about the fd number
+ *
+ * Not covered: writes by other processes, and offset users this shim does not interpose
+ * (sendfile, copy_file_range, splice, stdio's internal calls). stdio does its own buffering
+ * through libc-internal entry points, so FILE* streams are never affected.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+
+//user defines
+#define SHIM_MAX_FDS 1024
+#define SHIM_BUFFER (64 * 1024)
+
+//looks up libc's version of a call; copied bytewise because -Wpedantic forbids converting void * to a function
+//pointer, and storing through a (void **) cast breaks strict aliasing once the shim is optimised (-O2)
+#define RESOLVE(name) do { void *sym = dlsym(RTLD_NEXT, #name); memcpy(&real_##name, &sym, sizeof(sym)); } while (0)
+
+
+enum fd_state
+{
+    FD_UNKNOWN = 0, //not looked at yet
+    FD_BYPASS, //not a readable regular file, or shared with another fd
+    FD_HANDLED
+};
+
+struct fd_entry
+{
+    pthread_mutex_t lock;
+    enum fd_state state;
+    dev_t dev;
+    ino_t ino;
+    int append;
+    off_t pos; //virtual file offset
+    int synced; //1 if the kernel offset equals pos
+    char *window;
+    off_t window_off;
+    size_t window_len;
+};
+
+
+static struct fd_entry fds[SHIM_MAX_FDS];
+static size_t buffer_size = SHIM_BUFFER;
+static int handled_count = 0;
+static long stat_hits, stat_refills, stat_passthrough;
+
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_pread)(int, void *, size_t, off_t);
+static ssize_t (*real_readv)(int, const struct iovec *, int);
+static ssize_t (*real_write)(int, const void *, size_t);
+static ssize_t (*real_pwrite)(int, const void *, size_t, off_t);
+static off_t (*real_lseek)(int, off_t, int);
+static int (*real_close)(int);
+static int (*real_dup)(int);
+static int (*real_dup2)(int, int);
+static int (*real_dup3)(int, int, int);
+static int (*real_fcntl)(int, int, ...);
+static int (*real_open)(const char *, int, ...);
+static int (*real_openat)(int, const char *, int, ...);
+static int (*real_ftruncate)(int, off_t);
+
+
+static void sync_offset(struct fd_entry *e, int fd) //makes the kernel offset match the virtual one
+{
+    if (!e->synced)
+    {
+        real_lseek(fd, e->pos, SEEK_SET);
+        e->synced = 1;
+    }
+    return;
+}
+
+static void stop_handling(struct fd_entry *e, int fd) //caller holds e->lock
+{
+    if (e->state == FD_HANDLED)
+    {
+        sync_offset(e, fd);
+        e->window_len = 0;
+        __atomic_sub_fetch(&handled_count, 1, __ATOMIC_RELAXED);
+    }
+    e->state = FD_BYPASS;
+    return;
+}
+
+static void forget(int fd) //the fd number was closed or handed out anew
+{
+    if (fd < 0 || fd >= SHIM_MAX_FDS)
+    {
+        return;
+    }
+    struct fd_entry *e = &fds[fd];
+    pthread_mutex_lock(&e->lock);
+    if (e->state == FD_HANDLED)
+    {
+        __atomic_sub_fetch(&handled_count, 1, __ATOMIC_RELAXED);
+    }
+    e->state = FD_UNKNOWN;
+    e->window_len = 0;
+    pthread_mutex_unlock(&e->lock);
+    return;
+}
+
+static void bypass(int fd) //a second fd now shares this open file description
+{
+    if (fd < 0 || fd >= SHIM_MAX_FDS)
+    {
+        return;
+    }
+    struct fd_entry *e = &fds[fd];
+    pthread_mutex_lock(&e->lock);
+    stop_handling(e, fd);
+    pthread_mutex_unlock(&e->lock);
+    return;
+}
+
+static struct fd_entry *lookup(int fd) //locked entry of a handled fd, or NULL to pass the call through
+{
+    if (fd < 0 || fd >= SHIM_MAX_FDS || real_read == NULL)
+    {
+        return NULL;
+    }
+    struct fd_entry *e = &fds[fd];
+    pthread_mutex_lock(&e->lock);
+    if (e->state == FD_UNKNOWN)
+    {
+        struct stat st;
+        int flags = real_fcntl(fd, F_GETFL);
+        e->state = FD_BYPASS;
+        if (flags >= 0 && (flags & O_ACCMODE) != O_WRONLY && fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        {
+            off_t pos = real_lseek(fd, 0, SEEK_CUR);
+            if (pos >= 0 && (e->window != NULL || (e->window = malloc(buffer_size)) != NULL))
+            {
+                e->state = FD_HANDLED;
+                e->dev = st.st_dev;
+                e->ino = st.st_ino;
+                e->append = (flags & O_APPEND) != 0;
+                e->pos = pos;
+                e->synced = 1;
+                e->window_len = 0;
+                __atomic_add_fetch(&handled_count, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    if (e->state != FD_HANDLED)
+    {
+        pthread_mutex_unlock(&e->lock);
+        return NULL;
+    }
+    return e;
+}
+
+static void invalidate_inode(int fd) //a write through fd may change data cached for any fd on the same file
+{
+    struct stat st;
+    if (__atomic_load_n(&handled_count, __ATOMIC_RELAXED) == 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+    {
+        return;
+    }
+    for (int i = 0; i < SHIM_MAX_FDS; i++)
+    {
+        struct fd_entry *e = &fds[i];
+        if (__atomic_load_n(&e->state, __ATOMIC_RELAXED) != FD_HANDLED)
+        {
+            continue;
+        }
+        pthread_mutex_lock(&e->lock);
+        if (e->state == FD_HANDLED && e->dev == st.st_dev && e->ino == st.st_ino)
+        {
+            e->window_len = 0;
+        }
+        pthread_mutex_unlock(&e->lock);
+    }
+    return;
+}
+
+
+static void prepare_fork() //parent and child will share every offset, so hand them all back to the kernel
+{
+    for (int i = 0; i < SHIM_MAX_FDS; i++)
+    {
+        if (__atomic_load_n(&fds[i].state, __ATOMIC_RELAXED) == FD_HANDLED)
+        {
+            bypass(i);
+        }
+    }
+    return;
+}
+
+static void report()
+{
+    fprintf(stderr, "coalesce: %ld reads served from the window, %ld refills, %ld passed through\n",
+            stat_hits, stat_refills, stat_passthrough);
+    return;
+}
+
+__attribute__((constructor)) static void shim_init()
+{
+    RESOLVE(read);
+    RESOLVE(pread);
+    RESOLVE(readv);
+    RESOLVE(write);
+    RESOLVE(pwrite);
+    RESOLVE(lseek);
+    RESOLVE(close);
+    RESOLVE(dup);
+    RESOLVE(dup2);
+    RESOLVE(dup3);
+    RESOLVE(fcntl);
+    RESOLVE(open);
+    RESOLVE(openat);
+    RESOLVE(ftruncate);
+
+    for (int i = 0; i < SHIM_MAX_FDS; i++)
+    {
+        pthread_mutex_init(&fds[i].lock, NULL);
+    }
+
+    const char *size = getenv("COALESCE_BUFFER");
+    if (size != NULL && atol(size) > 0)
+    {
+        buffer_size = atol(size);
+    }
+    const char *stats = getenv("COALESCE_STATS");
+    if (stats != NULL && stats[0] == '1')
+    {
+        atexit(report);
+    }
+    pthread_atfork(prepare_fork, NULL, NULL);
+    return;
+}
+
+
+//Interposed calls
+ssize_t read(int fd, void *buf, size_t count)
+{
+    struct fd_entry *e = lookup(fd);
+    if (e == NULL)
+    {
+        return real_read(fd, buf, count);
+    }
+
+    char *out = buf;
+    size_t done = 0;
+    ssize_t x = 0;
+
+    //whatever the window already holds at pos is always served from it
+    while (done < count)
+    {
+        off_t end = e->window_off + (off_t)e->window_len;
+        if (e->pos >= e->window_off && e->pos < end)
+        {
+            size_t len = end - e->pos;
+            if (len > count - done)
+            {
+                len = count - done;
+            }
+            memcpy(out + done, e->window + (e->pos - e->window_off), len);
+            done += len;
+            e->pos += len;
+            e->synced = 0;
+            stat_hits++;
+            continue;
+        }
+
+        if (count - done >= buffer_size / 4) //large remainder: read it directly, it would not fit the window usefully
+        {
+            x = real_pread(fd, out + done, count - done, e->pos);
+            stat_passthrough++;
+            if (x > 0)
+            {
+                done += x;
+                e->pos += x;
+                e->synced = 0;
+            }
+            break;
+        }
+
+        x = real_pread(fd, e->window, buffer_size, e->pos);
+        stat_refills++;
+        if (x <= 0)
+        {
+            e->window_len = 0;
+            break;
+        }
+        e->window_off = e->pos;
+        e->window_len = x;
+    }
+
+    pthread_mutex_unlock(&e->lock);
+    if (done == 0 && x < 0)
+    {
+        return -1;
+    }
+    return done;
+}
+
+ssize_t __read_chk(int fd, void *buf, size_t count, size_t buflen) //fortified builds call this instead of read()
+{
+    if (count > buflen)
+    {
+        abort();
+    }
+    return read(fd, buf, count);
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset)
+{
+    struct fd_entry *e = lookup(fd);
+    if (e == NULL)
+    {
+        return real_pread(fd, buf, count, offset);
+    }
+
+    ssize_t x;
+    if (offset >= e->window_off && offset + (off_t)count <= e->window_off + (off_t)e->window_len) //fully inside the window
+    {
+        memcpy(buf, e->window + (offset - e->window_off), count);
+        stat_hits++;
+        x = count;
+    }
+    else if (count < buffer_size / 4) //small and outside: refill the window around it, the offset does not move
+    {
+        x = real_pread(fd, e->window, buffer_size, offset);
+        stat_refills++;
+        if (x > 0)
+        {
+            e->window_off = offset;
+            e->window_len = x;
+            x = ((size_t)x < count) ? x : (ssize_t)count;
+            memcpy(buf, e->window, x);
+        }
+        else
+        {
+            e->window_len = 0;
+        }
+    }
+    else
+    {
+        x = real_pread(fd, buf, count, offset);
+        stat_passthrough++;
+    }
+
+    pthread_mutex_unlock(&e->lock);
+    return x;
+}
+
+ssize_t pread64(int fd, void *buf, size_t count, off_t offset)
+{
+    return pread(fd, buf, count, offset);
+}
+
+off_t lseek(int fd, off_t offset, int whence)
+{
+    struct fd_entry *e = lookup(fd);
+    if (e == NULL)
+    {
+        return real_lseek(fd, offset, whence);
+    }
+
+    off_t pos;
+    if (whence == SEEK_SET || whence == SEEK_CUR) //purely virtual, no syscall
+    {
+        pos = (whence == SEEK_SET) ? offset : e->pos + offset;
+        if (pos < 0)
+        {
+            errno = EINVAL;
+            pos = -1;
+        }
+        else
+        {
+            e->pos = pos;
+            e->synced = 0;
+        }
+    }
+    else //SEEK_END, SEEK_DATA, SEEK_HOLE need the kernel
+    {
+        pos = real_lseek(fd, offset, whence);
+        if (pos >= 0)
+        {
+            e->pos = pos;
+            e->synced = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&e->lock);
+    return pos;
+}
+
+off_t lseek64(int fd, off_t offset, int whence)
+{
+    return lseek(fd, offset, whence);
+}
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    struct fd_entry *e = lookup(fd);
+    if (e == NULL)
+    {
+        return real_readv(fd, iov, iovcnt);
+    }
+    sync_offset(e, fd);
+    ssize_t x = real_readv(fd, iov, iovcnt);
+    if (x > 0)
+    {
+        e->pos += x;
+    }
+    pthread_mutex_unlock(&e->lock);
+    return x;
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+    struct fd_entry *e = lookup(fd);
+    if (e != NULL)
+    {
+        sync_offset(e, fd);
+        ssize_t x = real_write(fd, buf, count);
+        if (x > 0)
+        {
+            e->pos = e->append ? real_lseek(fd, 0, SEEK_CUR) : e->pos + x;
+        }
+        pthread_mutex_unlock(&e->lock);
+        if (x > 0)
+        {
+            invalidate_inode(fd);
+        }
+        return x;
+    }
+
+    ssize_t x = real_write(fd, buf, count);
+    if (x > 0 && fd > STDERR_FILENO)
+    {
+        invalidate_inode(fd);
+    }
+    return x;
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+    ssize_t x = real_pwrite(fd, buf, count, offset);
+    if (x > 0)
+    {
+        invalidate_inode(fd);
+    }
+    return x;
+}
+
+ssize_t pwrite64(int fd, const void *buf, size_t count, off_t offset)
+{
+    return pwrite(fd, buf, count, offset);
+}
+
+int ftruncate(int fd, off_t length)
+{
+    int x = real_ftruncate(fd, length);
+    if (x == 0)
+    {
+        invalidate_inode(fd);
+    }
+    return x;
+}
+
+int ftruncate64(int fd, off_t length)
+{
+    return ftruncate(fd, length);
+}
+
+int close(int fd)
+{
+    forget(fd);
+    return real_close(fd);
+}
+
+int dup(int oldfd)
+{
+    bypass(oldfd);
+    int fd = real_dup(oldfd);
+    forget(fd);
+    bypass(fd);
+    return fd;
+}
+
+int dup2(int oldfd, int newfd)
+{
+    bypass(oldfd);
+    int fd = real_dup2(oldfd, newfd);
+    forget(fd);
+    bypass(fd);
+    return fd;
+}
+
+int dup3(int oldfd, int newfd, int flags)
+{
+    bypass(oldfd);
+    int fd = real_dup3(oldfd, newfd, flags);
+    forget(fd);
+    bypass(fd);
+    return fd;
+}
+
+int fcntl(int fd, int cmd, ...)
+{
+    va_list ap;
+    va_start(ap, cmd);
+    void *arg = va_arg(ap, void *); //every fcntl argument fits a pointer sized register
+    va_end(ap);
+
+    if (cmd == F_DUPFD || cmd == F_DUPFD_CLOEXEC)
+    {
+        bypass(fd);
+        int newfd = real_fcntl(fd, cmd, arg);
+        forget(newfd);
+        bypass(newfd);
+        return newfd;
+    }
+    return real_fcntl(fd, cmd, arg);
+}
+
+int fcntl64(int fd, int cmd, ...)
+{
+    va_list ap;
+    va_start(ap, cmd);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+    return fcntl(fd, cmd, arg);
+}
+
+int open(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) //the mode argument only exists for these
+    {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+
+    int fd = real_open(path, flags, mode);
+    forget(fd);
+    return fd;
+}
+
+int open64(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) //the mode argument only exists for these
+    {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    return open(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) //the mode argument only exists for these
+    {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+
+    int fd = real_openat(dirfd, path, flags, mode);
+    forget(fd);
+    return fd;
+}
+
+int openat64(int dirfd, const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) //the mode argument only exists for these
+    {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    return openat(dirfd, path, flags, mode);
+}
+
+int creat(const char *path, mode_t mode)
+{
+    return open(path, O_CREAT | O_WRONLY | O_TRUNC, mode);
+}
+
+int creat64(const char *path, mode_t mode)
+{
+    return open(path, O_CREAT | O_WRONLY | O_TRUNC, mode);
+}
@@ -0,0 +1,359 @@
+#define _GNU_SOURCE //statx
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "time_sys_stdio.h"
+#include "uring.h"
+
+
+//user defines
+#define SMALL_DIR "smallfiles"
+#define SMALL_FILE_SIZE 4096
+#define SMALL_PER_DIR 1000 //files per sub directory, keeps directory lookups realistic for 1M files
+#define SMALL_BATCH 32 //open/read/close chains per io_uring submission
+#define SMALL_NAME 24 //"f" plus any long, so optimised builds can prove snprintf never truncates
+
+
+static void small_name(long i, char *path, size_t len, int relative) //"smallfiles/d0001/f001234", or just "f001234"
+{
+    if (relative)
+    {
+        snprintf(path, len, "f%06ld", i);
+    }
+    else
+    {
+        snprintf(path, len, SMALL_DIR "/d%04ld/f%06ld", i / SMALL_PER_DIR, i);
+    }
+    return;
+}
+
+static int generate_small_files(long count) //creates the tree once; a count stamp lets later runs reuse it
+{
+    char path[64];
+    long existing = 0;
+    FILE *stamp = fopen(SMALL_DIR "/count", "r");
+    if (stamp != NULL)
+    {
+        if (fscanf(stamp, "%ld", &existing) != 1)
+        {
+            existing = 0;
+        }
+        fclose(stamp);
+    }
+    if (existing >= count)
+    {
+        return 0;
+    }
+
+    if (mkdir(SMALL_DIR, 0755) < 0 && errno != EEXIST)
+    {
+        perror("Error Creating Directory");
+        return -1;
+    }
+
+    char data[SMALL_FILE_SIZE];
+    memset(data, 'x', sizeof(data));
+
+    printf("Generating %ld files of %d Bytes...\n", count, SMALL_FILE_SIZE);
+    for (long i = existing; i < count; i++)
+    {
+        if (i % SMALL_PER_DIR == 0)
+        {
+            snprintf(path, sizeof(path), SMALL_DIR "/d%04ld", i / SMALL_PER_DIR);
+            if (mkdir(path, 0755) < 0 && errno != EEXIST)
+            {
+                perror("Error Creating Directory");
+                return -1;
+            }
+        }
+        small_name(i, path, sizeof(path), 0);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || write(fd, data, sizeof(data)) != sizeof(data))
+        {
+            perror("Error Writing Small File");
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return -1;
+        }
+        close(fd);
+    }
+
+    stamp = fopen(SMALL_DIR "/count", "w");
+    if (stamp == NULL)
+    {
+        perror("Error Writing Count");
+        return -1;
+    }
+    fprintf(stamp, "%ld\n", count);
+    fclose(stamp);
+    return 0;
+}
+
+static int open_dirs(long count, int *dirs) //one directory fd per sub directory, shared by the *at() engines
+{
+    char path[64];
+    for (long d = 0; d * SMALL_PER_DIR < count; d++)
+    {
+        snprintf(path, sizeof(path), SMALL_DIR "/d%04ld", d);
+        dirs[d] = open(path, O_RDONLY | O_DIRECTORY);
+        if (dirs[d] < 0)
+        {
+            perror("Error Opening Directory");
+            while (d-- > 0)
+            {
+                close(dirs[d]);
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void close_dirs(long count, int *dirs)
+{
+    for (long d = 0; d * SMALL_PER_DIR < count; d++)
+    {
+        close(dirs[d]);
+    }
+    return;
+}
+
+
+//Engines: each reads every file once and returns the elapsed time, or -1
+static double small_open_read(long count) //full path open() + read() + close()
+{
+    char path[64];
+    char a[SMALL_FILE_SIZE];
+    double start = timestamp();
+
+    for (long i = 0; i < count; i++)
+    {
+        small_name(i, path, sizeof(path), 0);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            perror("Error Opening File");
+            return -1;
+        }
+        while (read(fd, a, sizeof(a)) > 0)
+        {
+        }
+        close(fd);
+    }
+
+    return timestamp() - start;
+}
+
+static double small_openat_read(long count, int *dirs) //openat() relative to the sub directory fd, no path walk from the cwd
+{
+    char name[SMALL_NAME];
+    char a[SMALL_FILE_SIZE];
+    double start = timestamp();
+
+    for (long i = 0; i < count; i++)
+    {
+        small_name(i, name, sizeof(name), 1);
+        int fd = openat(dirs[i / SMALL_PER_DIR], name, O_RDONLY);
+        if (fd < 0)
+        {
+            perror("Error Opening File");
+            return -1;
+        }
+        while (read(fd, a, sizeof(a)) > 0)
+        {
+        }
+        close(fd);
+    }
+
+    return timestamp() - start;
+}
+
+static double small_statx_read(long count, int *dirs) //statx() for the size first, then exactly one read() of that size
+{
+    char name[SMALL_NAME];
+    char a[SMALL_FILE_SIZE];
+    double start = timestamp();
+
+    for (long i = 0; i < count; i++)
+    {
+        struct statx stx;
+        int dir = dirs[i / SMALL_PER_DIR];
+        small_name(i, name, sizeof(name), 1);
+        if (statx(dir, name, AT_STATX_SYNC_AS_STAT, STATX_SIZE, &stx) < 0)
+        {
+            perror("Error Stating File");
+            return -1;
+        }
+        int fd = openat(dir, name, O_RDONLY);
+        if (fd < 0)
+        {
+            perror("Error Opening File");
+            return -1;
+        }
+        size_t len = stx.stx_size < sizeof(a) ? stx.stx_size : sizeof(a);
+        if (read(fd, a, len) < 0)
+        {
+            perror("Error Reading File");
+        }
+        close(fd);
+    }
+
+    return timestamp() - start;
+}
+
+static double small_uring(long count, int *dirs) //linked openat -> read -> close chains on direct descriptors, SMALL_BATCH per submit
+{
+    struct uring ring;
+    if (uring_init(&ring, SMALL_BATCH * 4) < 0)
+    {
+        perror("io_uring unavailable");
+        return -1;
+    }
+
+    int slots[SMALL_BATCH];
+    for (int i = 0; i < SMALL_BATCH; i++)
+    {
+        slots[i] = -1; //sparse direct descriptor table, filled by the opens
+    }
+    if (uring_register_files(&ring, slots, SMALL_BATCH) < 0)
+    {
+        perror("Error Registering Files");
+        uring_exit(&ring);
+        return -1;
+    }
+
+    static char buffers[SMALL_BATCH][SMALL_FILE_SIZE];
+    char names[SMALL_BATCH][SMALL_NAME];
+    long failed = 0;
+    double start = timestamp();
+
+    for (long base = 0; base < count; base += SMALL_BATCH)
+    {
+        int n = (count - base < SMALL_BATCH) ? (int)(count - base) : SMALL_BATCH;
+        for (int s = 0; s < n; s++)
+        {
+            long i = base + s;
+            small_name(i, names[s], sizeof(names[s]), 1);
+
+            struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = dirs[i / SMALL_PER_DIR];
+            sqe->addr = (unsigned long)names[s];
+            sqe->open_flags = O_RDONLY;
+            sqe->file_index = s + 1; //install into direct slot s
+            sqe->flags = IOSQE_IO_LINK;
+
+            sqe = uring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = s;
+            sqe->addr = (unsigned long)buffers[s];
+            sqe->len = SMALL_FILE_SIZE;
+            sqe->off = 0;
+            sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+
+            sqe = uring_get_sqe(&ring);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->file_index = s + 1;
+        }
+
+        if (uring_submit(&ring, n * 3) < 0)
+        {
+            perror("Error Submitting");
+            uring_exit(&ring);
+            return -1;
+        }
+
+        for (int c = 0; c < n * 3; c++)
+        {
+            struct io_uring_cqe *cqe;
+            while ((cqe = uring_peek_cqe(&ring)) == NULL)
+            {
+                uring_submit(&ring, 1);
+            }
+            if (cqe->res < 0)
+            {
+                failed++;
+            }
+            uring_cqe_seen(&ring);
+        }
+    }
+
+    double elapsed = timestamp() - start;
+    uring_exit(&ring);
+    if (failed > 0)
+    {
+        fprintf(stderr, "io_uring: %ld operations failed\n", failed);
+        return -1;
+    }
+    return elapsed;
+}
+
+
+void smallfiles(int runs, long count) //files/s for the open/stat/read/close variants over a tree of count small files
+{
+    if (generate_small_files(count) < 0)
+    {
+        return;
+    }
+
+    int *dirs = malloc(((count + SMALL_PER_DIR - 1) / SMALL_PER_DIR) * sizeof(int));
+    if (dirs == NULL || open_dirs(count, dirs) < 0)
+    {
+        free(dirs);
+        return;
+    }
+
+    printf("Read %ld files of %d Bytes (%d runs each)\n", count, SMALL_FILE_SIZE, runs);
+    printf("//////////////////////////////////////\n");
+    const char *names[] = {"open+read+close", "openat+read+close", "statx+openat+read", "io_uring chains"};
+    for (int m = 0; m < 4; m++)
+    {
+        double total = 0;
+        int i;
+        for (i = 0; i < runs; i++)
+        {
+            double t;
+            if (m == 0)
+            {
+                t = small_open_read(count);
+            }
+            else if (m == 1)
+            {
+                t = small_openat_read(count, dirs);
+            }
+            else if (m == 2)
+            {
+                t = small_statx_read(count, dirs);
+            }
+            else
+            {
+                t = small_uring(count, dirs);
+            }
+            if (t < 0)
+            {
+                break;
+            }
+            total += t;
+        }
+        if (i == runs)
+        {
+            printf("%-20s %12.0f files/s\n", names[m], count * runs / total);
+        }
+        else
+        {
+            printf("%-20s failed\n", names[m]);
+        }
+    }
+    printf("//////////////////////////////////////\n");
+
+    close_dirs(count, dirs);
+    free(dirs);
+    return;
+}
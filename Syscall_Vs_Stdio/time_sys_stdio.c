@@ -3,20 +3,35 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include "time_sys_stdio.h"
+#include "trace.h"
 
-//user defines
-#define CHUNK_SIZE 1024
-#define AVERAGE_RUNS 10
 
+const char *file_name = "file.txt"; //file read by every engine; workloads may point it at a copy
 
-void size() //shows size of the created file from the makefile; change the file size in the makefile directly
+
+void size() //shows size of the created file from the makefile; change SIZE in the makefile or run the generate workload
 {
-    FILE *file = fopen("file.txt", "r");
-    fseek(file, SEEK_CUR - 1, SEEK_END); // starts from 0th Byte till EOF
-    double size = ftell(file);
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL)
+    {
+        perror("Error Opening File");
+        return;
+    }
+    fseeko(file, 0, SEEK_END); // starts from 0th Byte till EOF; 64-bit offset so files beyond 2 GB report correctly
+    off_t size = ftello(file);
+    fclose(file);
 
-    if(size / (1024.0*1024.0) >= 0.5 )
+    if(size / (1024.0*1024.0*1024.0) >= 0.5 )
+    {
+        printf("Size of File in GB: %.3f \n", size/(1024.0*1024.0*1024.0));
+    }
+    else if(size / (1024.0*1024.0) >= 0.5 )
     {
         printf("Size of File in MB: %.3f \n", size/(1024.0*1024.0));
     }
@@ -26,7 +41,7 @@ void size() //shows size of the created file from the makefile; change the file
     }
     else
     {
-        printf("Size of File in Bytes: %f \n", size);
+        printf("Size of File in Bytes: %lld \n", (long long)size);
     }
     printf("//////////////////////////////////////\n");
     return;
@@ -35,7 +50,7 @@ void size() //shows size of the created file from the makefile; change the file
 double single_byte_syscall() //single byte latency using syscalls
 {
     struct timeval start, end;
-    int fd = open("file.txt", O_RDONLY);
+    int fd = open(file_name, O_RDONLY);
     if (fd < 0)
     {
         perror("Error Opening File");
@@ -44,7 +59,7 @@ double single_byte_syscall() //single byte latency using syscalls
     char a;
     gettimeofday(&start, NULL);
 
-    read(fd, &a, sizeof(a));
+    traced_read(fd, &a, sizeof(a));
 
     gettimeofday(&end, NULL);
     double latency_byte = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) /1000000.0;
@@ -56,21 +71,21 @@ double single_byte_syscall() //single byte latency using syscalls
 double file_per_byte_syscall() //time for reading the whole file in single bytes via syscalls
 {
     struct timeval start, end;
-    int fd = open("file.txt", O_RDONLY);
+    int fd = open(file_name, O_RDONLY);
     if (fd < 0)
     {
         perror("Error Opening File");
         return -1;
     }
     char a;
-    int x;
+    ssize_t x;
     gettimeofday(&start, NULL);
 
-    x = read(fd, &a, sizeof(a));
+    x = traced_read(fd, &a, sizeof(a));
 
-    while (x != 0)
+    while (x > 0)
     {
-        x = read(fd, &a, sizeof(a));
+        x = traced_read(fd, &a, sizeof(a));
     }
 
     gettimeofday(&end, NULL);
@@ -83,7 +98,7 @@ double file_per_byte_syscall() //time for reading the whole file in single bytes
 double single_chunk_syscall() //single chunk latency using syscalls
 {
     struct timeval start, end;
-    int fd = open("file.txt", O_RDONLY);
+    int fd = open(file_name, O_RDONLY);
     if (fd < 0)
     {
         perror("Error Opening File");
@@ -92,7 +107,7 @@ double single_chunk_syscall() //single chunk latency using syscalls
     char a[CHUNK_SIZE];
     gettimeofday(&start, NULL);
 
-    read(fd, a, sizeof(a));
+    traced_read(fd, a, sizeof(a));
 
     gettimeofday(&end, NULL);
     double latency_chunk = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) /1000000.0;
@@ -104,21 +119,21 @@ double single_chunk_syscall() //single chunk latency using syscalls
 double file_per_chunk_syscall() //time for reading the whole file in single chunks (1024 Bytes) via syscalls
 {
     struct timeval start, end;
-    int fd = open("file.txt", O_RDONLY);
+    int fd = open(file_name, O_RDONLY);
     if (fd < 0)
     {
         perror("Error Opening File");
         return -1;
     }
     char a[CHUNK_SIZE];
-    int x;
+    ssize_t x;
     gettimeofday(&start, NULL);
 
-    x = read(fd, a, sizeof(a));
+    x = traced_read(fd, a, sizeof(a));
 
-    while (x != 0)
+    while (x > 0)
     {
-        x = read(fd, a, sizeof(a));
+        x = traced_read(fd, a, sizeof(a));
     }
 
     gettimeofday(&end, NULL);
@@ -132,7 +147,7 @@ double single_byte_stdio() //single time latency using stdio
 {
     struct timeval start, end;
 
-    FILE *file = fopen("file.txt", "r");
+    FILE *file = fopen(file_name, "r");
     if (file == NULL)
     {
         perror("Error Opening File");
@@ -141,7 +156,7 @@ double single_byte_stdio() //single time latency using stdio
 
     gettimeofday(&start, NULL);
 
-    fgetc(file);
+    traced_fgetc(file);
 
     gettimeofday(&end, NULL);
 
@@ -154,7 +169,7 @@ double single_byte_stdio() //single time latency using stdio
 double file_per_byte_stdio() //time for reading the whole file in single bytes via stdio
 {
     struct timeval start, end;
-    FILE *file = fopen("file.txt", "r");
+    FILE *file = fopen(file_name, "r");
     int ch;
     if (file == NULL)
     {
@@ -164,11 +179,11 @@ double file_per_byte_stdio() //time for reading the whole file in single bytes v
 
     gettimeofday(&start, NULL);
 
-    ch = fgetc(file);
+    ch = traced_fgetc(file);
 
     while (ch != EOF)
     {
-        ch = fgetc(file);
+        ch = traced_fgetc(file);
     }
 
     gettimeofday(&end, NULL);
@@ -183,7 +198,7 @@ double single_chunk_stdio() //single chunk latency using stdio
 {
     struct timeval start, end;
     char a[1024];
-    FILE *file = fopen("file.txt", "r");
+    FILE *file = fopen(file_name, "r");
     if (file == NULL)
     {
         perror("Error Opening File");
@@ -192,7 +207,7 @@ double single_chunk_stdio() //single chunk latency using stdio
 
     gettimeofday(&start, NULL);
 
-    fread(a, sizeof(char), CHUNK_SIZE, file);
+    traced_fread(a, sizeof(char), CHUNK_SIZE, file);
 
     gettimeofday(&end, NULL);
 
@@ -206,20 +221,20 @@ double file_per_chunk_stdio() //function for timing for reading the whole file i
 {
     struct timeval start, end;
     char a[1024];
-    FILE *file = fopen("file.txt", "r");
+    FILE *file = fopen(file_name, "r");
     if (file == NULL)
     {
         perror("Error Opening File");
         return -1;
     }
-    int x;
+    size_t x;
 
     gettimeofday(&start, NULL);
 
-    x = fread(a, sizeof(char), CHUNK_SIZE, file);
+    x = traced_fread(a, sizeof(char), CHUNK_SIZE, file);
     while (x > 0)
     {
-        x = fread(a, sizeof(char), CHUNK_SIZE, file);
+        x = traced_fread(a, sizeof(char), CHUNK_SIZE, file);
     }
     gettimeofday(&end, NULL); 
 
@@ -229,6 +244,81 @@ double file_per_chunk_stdio() //function for timing for reading the whole file i
     return latency_byte;
 }
 
+double file_mmap() //time for reading the whole file through a mapping, copied out in chunks like read() does
+{
+    struct timeval start, end;
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error Opening File");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        close(fd);
+        return -1;
+    }
+    char a[CHUNK_SIZE];
+    gettimeofday(&start, NULL);
+
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("Error Mapping File");
+        close(fd);
+        return -1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    for (off_t off = 0; off < st.st_size; off += CHUNK_SIZE)
+    {
+        size_t len = (st.st_size - off < CHUNK_SIZE) ? (size_t)(st.st_size - off) : CHUNK_SIZE;
+        memcpy(a, map + off, len);
+        __asm__ __volatile__("" : : "r"(a) : "memory"); //keep the copy from being optimised away
+    }
+    munmap(map, st.st_size);
+
+    gettimeofday(&end, NULL);
+    double latency_map = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) /1000000.0;
+
+    close(fd);
+    return latency_map;
+}
+
+double engine(char a) //one run of the engine average() knows under the same letter; -1 for an unknown letter
+{
+    switch (a)
+    {
+        case 'a': return single_byte_stdio();
+        case 'b': return file_per_byte_stdio();
+        case 'c': return single_chunk_stdio();
+        case 'd': return file_per_chunk_stdio();
+        case 'e': return single_byte_syscall();
+        case 'f': return file_per_byte_syscall();
+        case 'g': return single_chunk_syscall();
+        case 'h': return file_per_chunk_syscall();
+        case 'i': return file_mmap();
+        default: return -1;
+    }
+}
+
+int engine_single(char a) //1 for the single call latencies ('a', 'c', 'e', 'g'), 0 for whole file times ('b', 'd', 'f', 'h', 'i')
+{
+    return a >= 'a' && a <= 'h' && (a - 'a') % 2 == 0;
+}
+
+static char word_letter(const char *word, const char *const words[]) //first letter of the entry matching word exactly, 0 if none does
+{
+    for (int i = 0; words[i] != NULL; i++)
+    {
+        if (strcmp(word, words[i]) == 0)
+        {
+            return words[i][0];
+        }
+    }
+    return 0;
+}
+
 void average(char a, int size) //runs the following command for a given size (default: 10)
 {
     double avg = 0;
@@ -297,6 +387,14 @@ void average(char a, int size) //runs the following command for a given size (de
         }
         printf("Average of %d runs of file in chunks time (syscall): %f\n", size, avg/size);
     }
+    else if (a == 'i')
+    {
+        for (int i = 0; i < size; i++)
+        {
+            avg = avg + file_mmap();
+        }
+        printf("Average of %d runs of file via mmap time: %f\n", size, avg/size);
+    }
     else
     {
         perror("Input invalid method");
@@ -358,8 +456,128 @@ void syscalls(int runs) //takes in the amount of runs for the average function;
     return;
 }
 
-int main()
+double timestamp() //monotonic clock in seconds; gettimeofday is too coarse for per-call latencies
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static int compare_double(const void *a, const void *b)
 {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void sort_samples(double *samples, long n)
+{
+    qsort(samples, n, sizeof(double), compare_double);
+    return;
+}
+
+double percentile(const double *sorted, long n, double p) //nearest rank on samples sorted by sort_samples(); 0 without samples
+{
+    if (n <= 0)
+    {
+        return 0;
+    }
+    long i = (long)(p / 100.0 * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+int main(int argc, char *argv[]) //no argument runs the stdio/syscall comparison; otherwise the named workload
+{
+    if (argc > 1)
+    {
+        if (strcmp(argv[1], "records") == 0)
+        {
+            records(AVERAGE_RUNS);
+        }
+        else if (strcmp(argv[1], "smallfiles") == 0) //optional file count, default 10k
+        {
+            long count = argc > 2 ? atol(argv[2]) : 10000;
+            if (count <= 0)
+            {
+                fprintf(stderr, "Usage: %s smallfiles [file count > 0]\n", argv[0]);
+                exit(1);
+            }
+            smallfiles(AVERAGE_RUNS, count);
+        }
+        else if (strcmp(argv[1], "dirscan") == 0) //optional max thread count, default twice the online cores
+        {
+            dirscan(AVERAGE_RUNS, argc > 2 ? atoi(argv[2]) : 2 * sysconf(_SC_NPROCESSORS_ONLN));
+        }
+        else if (strcmp(argv[1], "contention") == 0) //optional reader count, default 4
+        {
+            contention(AVERAGE_RUNS, argc > 2 ? atoi(argv[2]) : 4);
+        }
+        else if (strcmp(argv[1], "interference") == 0) //optional engine letters, default single chunk + whole file (syscall)
+        {
+            interference(argc > 2 ? argv[2] : "gh");
+        }
+        else if (strcmp(argv[1], "generate") == 0) //size [zero|random|compressible] [write|fallocate|sparse] [path]
+        {
+            static const char *const contents[] = {"zero", "random", "compressible", NULL};
+            static const char *const allocations[] = {"write", "fallocate", "sparse", NULL};
+            char content = argc > 3 ? word_letter(argv[3], contents) : 'z';
+            char allocation = argc > 4 ? word_letter(argv[4], allocations) : 'w';
+            if (argc < 3 || content == 0 || allocation == 0)
+            {
+                fprintf(stderr, "Usage: %s generate <size[K|M|G|T]> [zero|random|compressible] [write|fallocate|sparse] [path]\n", argv[0]);
+                exit(1);
+            }
+            exit(generate(argc > 5 ? argv[5] : "file.txt", parse_size(argv[2]), content, allocation) < 0 ? 1 : 0);
+        }
+        else if (strcmp(argv[1], "async") == 0) //optional queue depth (default "sweep" over 1..64) and block size
+        {
+            int depth = (argc > 2 && strcmp(argv[2], "sweep") != 0) ? atoi(argv[2]) : 0;
+            off_t block = argc > 3 ? parse_size(argv[3]) : CHUNK_SIZE;
+            if ((argc > 2 && strcmp(argv[2], "sweep") != 0 && depth <= 0) || block <= 0)
+            {
+                fprintf(stderr, "Usage: %s async [queue depth > 0|sweep] [block size > 0[K|M|G|T]]\n", argv[0]);
+                exit(1);
+            }
+            async_reads(3, depth, (size_t)block);
+        }
+        else if (strcmp(argv[1], "trace") == 0) //optional engine letters (default 'd' and 'h') and events kept per thread
+        {
+            trace_engines(argc > 2 ? argv[2] : "dh", argc > 3 ? (size_t)atol(argv[3]) : 1 << 20);
+        }
+        else if (strcmp(argv[1], "ipc") == 0) //optional pipe buffer size for F_SETPIPE_SZ, default 1M
+        {
+            ipc_streams(AVERAGE_RUNS, argc > 2 ? (int)parse_size(argv[2]) : 1024 * 1024);
+        }
+        else if (strcmp(argv[1], "copy") == 0)
+        {
+            copies(3);
+        }
+        else if (strcmp(argv[1], "latency") == 0) //optional block size (default 4K) and spin-then-block budget in us (default 50)
+        {
+            off_t block = argc > 2 ? parse_size(argv[2]) : 4096;
+            if (block <= 0)
+            {
+                fprintf(stderr, "Usage: %s latency [block size > 0[K|M|G|T]] [spin budget in us]\n", argv[0]);
+                exit(1);
+            }
+            latency((size_t)block, argc > 3 ? atol(argv[3]) : 50);
+        }
+        else if (strcmp(argv[1], "autotune") == 0) //optional file (default file.txt), "force" to re-probe a cached device
+        {
+            autotune(argc > 2 ? argv[2] : file_name, argc > 3 && strcmp(argv[3], "force") == 0);
+        }
+        else if (strcmp(argv[1], "baselines") == 0) //optional engine letters, default all but the 50M read() calls of 'f'
+        {
+            baselines(3, argc > 2 ? argv[2] : "abcdeghi");
+        }
+        else
+        {
+            fprintf(stderr, "Unknown workload: %s\n", argv[1]);
+            exit(1);
+        }
+        exit(0);
+    }
+
     size();
     stdio(AVERAGE_RUNS);
     syscalls(AVERAGE_RUNS);
@@ -0,0 +1,46 @@
+#ifndef TIME_SYS_STDIO_H_
+#define TIME_SYS_STDIO_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+
+//user defines
+#define CHUNK_SIZE 1024
+#define AVERAGE_RUNS 10
+
+
+//shared helpers (time_sys_stdio.c)
+extern const char *file_name; //"file.txt" unless a workload redirects the engines
+double timestamp(); //monotonic time in seconds, for workloads that need better than gettimeofday resolution
+void sort_samples(double *samples, long n);
+double percentile(const double *sorted, long n, double p); //p in 0..100, 0 if n <= 0
+double engine(char a); //one run of an engine, by its average() letter ('a'..'h', 'i' for mmap)
+int engine_single(char a); //1 if the engine times a single call rather than the whole file
+
+
+//workloads, selected by name on the command line
+void records(int runs); //records.c
+void smallfiles(int runs, long count); //smallfiles.c
+void dirscan(int runs, int max_threads); //dirscan.c
+void contention(int runs, int readers); //contention.c
+void interference(const char *engines); //noise.c
+void baselines(int runs, const char *engines); //baselines.c
+void async_reads(int runs, int depth, size_t block); //async.c
+void trace_engines(const char *engines, size_t capacity); //trace.c
+void ipc_streams(int runs, int pipe_size); //ipc.c
+void copies(int runs); //copy.c
+void latency(size_t block, long spin_us); //latency.c
+void autotune(const char *path, int force); //autotune.c, library call in autotune.h
+
+
+//test data generator (generate.c)
+off_t parse_size(const char *text); //"50000K", "4G", plain bytes; -1 if malformed
+int generate(const char *path, off_t size, char content, char allocation); //content 'z'ero/'r'andom/'c'ompressible, allocation 'w'rite/'f'allocate/'s'parse
+
+
+//co-running noise (noise.c): start intensity threads of a kind ('m'emcpy, page 'c'ache, 'w'riter) around any engine
+int noise_start(char kind, int intensity);
+void noise_stop();
+
+#endif /* TIME_SYS_STDIO_H_ */
@@ -0,0 +1,215 @@
+#define _GNU_SOURCE //gettid
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "time_sys_stdio.h"
+#include "trace.h"
+
+
+//user defines
+#define TRACE_MAX_THREADS 256
+
+
+struct trace_event //binary sample, 24 Bytes
+{
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int32_t bytes;
+    char call; //'r'ead, 'f'read, fget'g'
+};
+
+struct trace_ring
+{
+    pid_t tid;
+    struct trace_event *events;
+    uint64_t written; //total events ever recorded; the ring holds the last min(written, capacity)
+};
+
+
+int trace_on = 0;
+
+static size_t trace_capacity;
+static struct trace_ring trace_rings[TRACE_MAX_THREADS];
+static int trace_ring_count = 0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct trace_ring *trace_mine; //this thread's ring, claimed on its first event
+static __thread int trace_generation_seen = -1;
+static int trace_generation = 0; //bumped by trace_start so threads claim fresh rings
+
+
+static struct trace_ring *trace_claim() //allocates the calling thread's ring up front, outside any timed call
+{
+    struct trace_ring *ring = NULL;
+    pthread_mutex_lock(&trace_lock);
+    if (trace_ring_count < TRACE_MAX_THREADS)
+    {
+        ring = &trace_rings[trace_ring_count];
+        ring->events = malloc(trace_capacity * sizeof(struct trace_event));
+        if (ring->events != NULL)
+        {
+            memset(ring->events, 0, trace_capacity * sizeof(struct trace_event)); //fault the pages in now
+            ring->tid = gettid();
+            ring->written = 0;
+            trace_ring_count++;
+        }
+        else
+        {
+            ring = NULL;
+        }
+    }
+    pthread_mutex_unlock(&trace_lock);
+    return ring;
+}
+
+int trace_start(size_t capacity)
+{
+    if (capacity == 0) //ring positions are taken modulo the capacity
+    {
+        fprintf(stderr, "Trace capacity must be at least 1 event\n");
+        return -1;
+    }
+    trace_stop();
+    pthread_mutex_lock(&trace_lock);
+    for (int i = 0; i < trace_ring_count; i++)
+    {
+        free(trace_rings[i].events);
+    }
+    trace_ring_count = 0;
+    trace_capacity = capacity;
+    trace_generation++;
+    pthread_mutex_unlock(&trace_lock);
+
+    //the starting thread gets its ring now so the first traced call is not slowed by the allocation
+    trace_mine = trace_claim();
+    trace_generation_seen = trace_generation;
+    if (trace_mine == NULL)
+    {
+        perror("Error Allocating Trace Buffer");
+        return -1;
+    }
+    __atomic_store_n(&trace_on, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void trace_stop()
+{
+    __atomic_store_n(&trace_on, 0, __ATOMIC_RELEASE);
+    return;
+}
+
+void trace_record(char call, uint64_t start_ns, uint64_t end_ns, long bytes)
+{
+    if (trace_generation_seen != trace_generation)
+    {
+        trace_mine = trace_claim();
+        trace_generation_seen = trace_generation;
+    }
+    if (trace_mine == NULL)
+    {
+        return;
+    }
+    struct trace_event *e = &trace_mine->events[trace_mine->written % trace_capacity];
+    e->start_ns = start_ns;
+    e->end_ns = end_ns;
+    e->bytes = (int32_t)bytes;
+    e->call = call;
+    trace_mine->written++;
+    return;
+}
+
+
+static const char *trace_call_name(char call)
+{
+    return call == 'r' ? "read" : call == 'f' ? "fread" : "fgetc";
+}
+
+int trace_export(const char *json_path, const char *csv_path)
+{
+    FILE *json = fopen(json_path, "w");
+    FILE *csv = fopen(csv_path, "w");
+    if (json == NULL || csv == NULL)
+    {
+        perror("Error Writing Trace");
+        if (json != NULL)
+        {
+            fclose(json);
+        }
+        if (csv != NULL)
+        {
+            fclose(csv);
+        }
+        return -1;
+    }
+
+    //timestamps are exported relative to the earliest kept event
+    uint64_t origin = UINT64_MAX;
+    for (int t = 0; t < trace_ring_count; t++)
+    {
+        struct trace_ring *ring = &trace_rings[t];
+        uint64_t kept = ring->written < trace_capacity ? ring->written : trace_capacity;
+        if (kept > 0)
+        {
+            uint64_t first = ring->events[(ring->written - kept) % trace_capacity].start_ns;
+            origin = first < origin ? first : origin;
+        }
+    }
+
+    int first = 1;
+    fprintf(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(csv, "tid,call,start_ns,end_ns,duration_ns,bytes\n");
+    for (int t = 0; t < trace_ring_count; t++)
+    {
+        struct trace_ring *ring = &trace_rings[t];
+        uint64_t kept = ring->written < trace_capacity ? ring->written : trace_capacity;
+        for (uint64_t i = ring->written - kept; i < ring->written; i++)
+        {
+            struct trace_event *e = &ring->events[i % trace_capacity];
+            uint64_t start = e->start_ns - origin;
+            uint64_t end = e->end_ns - origin;
+            fprintf(json, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"bytes\":%d}}",
+                    first ? "" : ",\n", trace_call_name(e->call), getpid(), ring->tid, start / 1000.0, (end - start) / 1000.0, e->bytes);
+            fprintf(csv, "%d,%s,%llu,%llu,%llu,%d\n", ring->tid, trace_call_name(e->call),
+                    (unsigned long long)start, (unsigned long long)end, (unsigned long long)(end - start), e->bytes);
+            first = 0;
+        }
+        if (ring->written > kept)
+        {
+            fprintf(stderr, "trace: thread %d dropped its oldest %llu events (ring of %zu)\n",
+                    ring->tid, (unsigned long long)(ring->written - kept), trace_capacity);
+        }
+    }
+    fprintf(json, "\n]}\n");
+
+    fclose(json);
+    fclose(csv);
+    return 0;
+}
+
+
+void trace_engines(const char *engines, size_t capacity) //runs each engine AVERAGE_RUNS times with tracing on
+{
+    if (trace_start(capacity) < 0)
+    {
+        return;
+    }
+    for (const char *e = engines; *e != '\0'; e++)
+    {
+        for (int i = 0; i < AVERAGE_RUNS; i++)
+        {
+            if (engine(*e) < 0)
+            {
+                fprintf(stderr, "Engine %c failed\n", *e);
+                break;
+            }
+        }
+    }
+    trace_stop();
+
+    if (trace_export("trace.json", "trace.csv") == 0)
+    {
+        printf("Traced engines %s: trace.json (chrome://tracing, ui.perfetto.dev) and trace.csv\n", engines);
+    }
+    return;
+}
@@ -0,0 +1,62 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+
+//Per-call tracer: engines call traced_read()/traced_fread()/traced_fgetc() instead of the plain calls.
+//While tracing is off each wrapper costs one predictable branch.
+extern int trace_on;
+
+int trace_start(size_t capacity); //capacity = events kept per thread (ring buffer, oldest overwritten); -1 if 0 or out of memory
+void trace_stop();
+int trace_export(const char *json_path, const char *csv_path); //Chrome trace-event JSON and CSV; 0 on success
+void trace_record(char call, uint64_t start_ns, uint64_t end_ns, long bytes);
+
+static inline uint64_t trace_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline ssize_t traced_read(int fd, void *buf, size_t count)
+{
+    if (!trace_on)
+    {
+        return read(fd, buf, count);
+    }
+    uint64_t start = trace_now();
+    ssize_t x = read(fd, buf, count);
+    trace_record('r', start, trace_now(), x);
+    return x;
+}
+
+static inline size_t traced_fread(void *buf, size_t size, size_t count, FILE *file)
+{
+    if (!trace_on)
+    {
+        return fread(buf, size, count, file);
+    }
+    uint64_t start = trace_now();
+    size_t x = fread(buf, size, count, file);
+    trace_record('f', start, trace_now(), (long)(x * size));
+    return x;
+}
+
+static inline int traced_fgetc(FILE *file)
+{
+    if (!trace_on)
+    {
+        return fgetc(file);
+    }
+    uint64_t start = trace_now();
+    int ch = fgetc(file);
+    trace_record('g', start, trace_now(), ch == EOF ? 0 : 1);
+    return ch;
+}
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,36 @@
+#ifndef URING_H_
+#define URING_H_
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+
+//Minimal io_uring wrapper on the raw syscalls (no liburing dependency)
+struct uring
+{
+    int fd;
+    unsigned entries;
+
+    //submission ring
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sqe_tail; //locally filled, not yet published to the kernel
+    unsigned sqe_head;
+
+    //completion ring
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_map, *cq_map;
+    size_t sq_map_size, cq_map_size, sqes_size;
+};
+
+int uring_init(struct uring *ring, unsigned entries); //0 on success, -1 (errno set) if io_uring is unavailable
+void uring_exit(struct uring *ring);
+struct io_uring_sqe *uring_get_sqe(struct uring *ring); //zeroed sqe, or NULL if the submission ring is full
+int uring_submit(struct uring *ring, unsigned wait_nr); //publishes queued sqes and waits for wait_nr completions
+struct io_uring_cqe *uring_peek_cqe(struct uring *ring); //next completion, or NULL
+void uring_cqe_seen(struct uring *ring);
+int uring_register_files(struct uring *ring, const int *fds, unsigned count); //fds may be -1 for sparse slots
+
+#endif /* URING_H_ */